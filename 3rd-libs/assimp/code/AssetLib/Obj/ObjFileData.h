@@ -59,24 +59,40 @@ struct Material;
 // ------------------------------------------------------------------------------------------------
 //! \struct Face
 //! \brief  Data structure for a simple obj-face, describes discredit,l.ation and materials
+//!
+//! Faces are stored by value in Mesh::m_Faces. Their indices live in the index pools
+//! of the owning mesh, a face only records where its range starts and how long it is.
 // ------------------------------------------------------------------------------------------------
 struct Face {
     using IndexArray = std::vector<unsigned int>;
 
     //! Primitive type
     aiPrimitiveType mPrimitiveType;
-    //! Vertex indices
-    IndexArray m_vertices;
-    //! Normal indices
-    IndexArray m_normals;
-    //! Texture coordinates indices
-    IndexArray m_texturCoords;
+    //! First vertex index in Mesh::m_vertexIndices
+    unsigned int m_firstVertex;
+    //! Number of vertex indices
+    unsigned int m_numVertices;
+    //! First normal index in Mesh::m_normalIndices
+    unsigned int m_firstNormal;
+    //! Number of normal indices
+    unsigned int m_numNormals;
+    //! First texture coordinate index in Mesh::m_texCoordIndices
+    unsigned int m_firstTexCoord;
+    //! Number of texture coordinate indices
+    unsigned int m_numTexCoords;
     //! Pointer to assigned material
     Material *m_pMaterial;
 
     //! \brief  Default constructor
     Face(aiPrimitiveType pt = aiPrimitiveType_POLYGON) :
-            mPrimitiveType(pt), m_vertices(), m_normals(), m_texturCoords(), m_pMaterial(nullptr) {
+            mPrimitiveType(pt),
+            m_firstVertex(0),
+            m_numVertices(0),
+            m_firstNormal(0),
+            m_numNormals(0),
+            m_firstTexCoord(0),
+            m_numTexCoords(0),
+            m_pMaterial(nullptr) {
         // empty
     }
 
@@ -227,8 +243,12 @@ struct Mesh {
     static const unsigned int NoMaterial = ~0u;
     /// The name for the mesh
     std::string m_name;
-    /// Array with pointer to all stored faces
-    std::vector<Face*> m_Faces;
+    /// All stored faces, contiguous
+    std::vector<Face> m_Faces;
+    /// Shared index pools, addressed by the ranges stored in each face
+    Face::IndexArray m_vertexIndices;
+    Face::IndexArray m_normalIndices;
+    Face::IndexArray m_texCoordIndices;
     /// Assigned material
     Material *m_pMaterial;
     /// Number of stored indices.
@@ -251,12 +271,7 @@ struct Mesh {
     }
 
     /// Destructor
-    ~Mesh() {
-        for (std::vector<Face *>::iterator it = m_Faces.begin();
-                it != m_Faces.end(); ++it) {
-            delete *it;
-        }
-    }
+    ~Mesh() = default;
 };
 
 // ------------------------------------------------------------------------------------------------
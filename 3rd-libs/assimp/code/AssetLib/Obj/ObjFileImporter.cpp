@@ -334,17 +334,17 @@ std::unique_ptr<aiMesh> ObjFileImporter::createTopology(const ObjFile::Model *pM
     }
 
     for (size_t index = 0; index < pObjMesh->m_Faces.size(); index++) {
-        const ObjFile::Face *inp = pObjMesh->m_Faces[index];
+        const ObjFile::Face *inp = &pObjMesh->m_Faces[index];
 
         if (inp->mPrimitiveType == aiPrimitiveType_LINE) {
-            pMesh->mNumFaces += static_cast<unsigned int>(inp->m_vertices.size() - 1);
+            pMesh->mNumFaces += inp->m_numVertices - 1;
             pMesh->mPrimitiveTypes |= aiPrimitiveType_LINE;
         } else if (inp->mPrimitiveType == aiPrimitiveType_POINT) {
-            pMesh->mNumFaces += static_cast<unsigned int>(inp->m_vertices.size());
+            pMesh->mNumFaces += inp->m_numVertices;
             pMesh->mPrimitiveTypes |= aiPrimitiveType_POINT;
         } else {
             ++pMesh->mNumFaces;
-            if (inp->m_vertices.size() > 3) {
+            if (inp->m_numVertices > 3) {
                 pMesh->mPrimitiveTypes |= aiPrimitiveType_POLYGON;
             } else {
                 pMesh->mPrimitiveTypes |= aiPrimitiveType_TRIANGLE;
@@ -363,16 +363,16 @@ std::unique_ptr<aiMesh> ObjFileImporter::createTopology(const ObjFile::Model *pM
 
         // Copy all data from all stored meshes
         for (auto &face : pObjMesh->m_Faces) {
-            const ObjFile::Face *inp = face;
+            const ObjFile::Face *inp = &face;
             if (inp->mPrimitiveType == aiPrimitiveType_LINE) {
-                for (size_t i = 0; i < inp->m_vertices.size() - 1; ++i) {
+                for (size_t i = 0; i + 1 < inp->m_numVertices; ++i) {
                     aiFace &f = pMesh->mFaces[outIndex++];
                     uiIdxCount += f.mNumIndices = 2;
                     f.mIndices = new unsigned int[2];
                 }
                 continue;
             } else if (inp->mPrimitiveType == aiPrimitiveType_POINT) {
-                for (size_t i = 0; i < inp->m_vertices.size(); ++i) {
+                for (size_t i = 0; i < inp->m_numVertices; ++i) {
                     aiFace &f = pMesh->mFaces[outIndex++];
                     uiIdxCount += f.mNumIndices = 1;
                     f.mIndices = new unsigned int[1];
@@ -381,7 +381,7 @@ std::unique_ptr<aiMesh> ObjFileImporter::createTopology(const ObjFile::Model *pM
             }
 
             aiFace *pFace = &pMesh->mFaces[outIndex++];
-            const unsigned int uiNumIndices = (unsigned int)face->m_vertices.size();
+            const unsigned int uiNumIndices = face.m_numVertices;
             uiIdxCount += pFace->mNumIndices = (unsigned int)uiNumIndices;
             if (pFace->mNumIndices > 0) {
                 pFace->mIndices = new unsigned int[uiNumIndices];
@@ -441,10 +441,11 @@ void ObjFileImporter::createVertexArray(const ObjFile::Model *pModel,
     // Copy vertices, normals and textures into aiMesh instance
     bool normalsok = true, uvok = true;
     unsigned int newIndex = 0, outIndex = 0;
-    for (auto sourceFace : pObjMesh->m_Faces) {
+    for (const auto &face : pObjMesh->m_Faces) {
+        const ObjFile::Face *sourceFace = &face;
         // Copy all index arrays
-        for (size_t vertexIndex = 0, outVertexIndex = 0; vertexIndex < sourceFace->m_vertices.size(); vertexIndex++) {
-            const unsigned int vertex = sourceFace->m_vertices.at(vertexIndex);
+        for (size_t vertexIndex = 0, outVertexIndex = 0; vertexIndex < sourceFace->m_numVertices; vertexIndex++) {
+            const unsigned int vertex = pObjMesh->m_vertexIndices[sourceFace->m_firstVertex + vertexIndex];
             if (vertex >= pModel->mVertices.size()) {
                 throw DeadlyImportError("OBJ: vertex index out of range");
             }
@@ -456,8 +457,8 @@ void ObjFileImporter::createVertexArray(const ObjFile::Model *pModel,
             pMesh->mVertices[newIndex] = pModel->mVertices[vertex];
 
             // Copy all normals
-            if (normalsok && !pModel->mNormals.empty() && vertexIndex < sourceFace->m_normals.size()) {
-                const unsigned int normal = sourceFace->m_normals.at(vertexIndex);
+            if (normalsok && !pModel->mNormals.empty() && vertexIndex < sourceFace->m_numNormals) {
+                const unsigned int normal = pObjMesh->m_normalIndices[sourceFace->m_firstNormal + vertexIndex];
                 if (normal >= pModel->mNormals.size()) {
                     normalsok = false;
                 } else {
@@ -472,8 +473,8 @@ void ObjFileImporter::createVertexArray(const ObjFile::Model *pModel,
             }
 
             // Copy all texture coordinates
-            if (uvok && !pModel->mTextureCoord.empty() && vertexIndex < sourceFace->m_texturCoords.size()) {
-                const unsigned int tex = sourceFace->m_texturCoords.at(vertexIndex);
+            if (uvok && !pModel->mTextureCoord.empty() && vertexIndex < sourceFace->m_numTexCoords) {
+                const unsigned int tex = pObjMesh->m_texCoordIndices[sourceFace->m_firstTexCoord + vertexIndex];
 
                 if (tex >= pModel->mTextureCoord.size()) {
                     uvok = false;
@@ -486,7 +487,7 @@ void ObjFileImporter::createVertexArray(const ObjFile::Model *pModel,
             // Get destination face
             aiFace *pDestFace = &pMesh->mFaces[outIndex];
 
-            const bool last = (vertexIndex == sourceFace->m_vertices.size() - 1);
+            const bool last = (vertexIndex == sourceFace->m_numVertices - 1);
             if (sourceFace->mPrimitiveType != aiPrimitiveType_LINE || !last) {
                 pDestFace->mIndices[outVertexIndex] = newIndex;
                 outVertexIndex++;
@@ -508,7 +509,7 @@ void ObjFileImporter::createVertexArray(const ObjFile::Model *pModel,
                         }
 
                         pMesh->mVertices[newIndex + 1] = pMesh->mVertices[newIndex];
-                        if (!sourceFace->m_normals.empty() && !pModel->mNormals.empty()) {
+                        if (sourceFace->m_numNormals != 0 && !pModel->mNormals.empty()) {
                             pMesh->mNormals[newIndex + 1] = pMesh->mNormals[newIndex];
                         }
                         if (!pModel->mTextureCoord.empty()) {
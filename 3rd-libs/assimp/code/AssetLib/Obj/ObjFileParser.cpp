@@ -438,7 +438,11 @@ void ObjFileParser::getFace(aiPrimitiveType type) {
         return;
     }
 
-    ObjFile::Face *face = new ObjFile::Face(type);
+    // indices are collected in reusable scratch arrays and appended to the mesh pools at the end
+    m_faceVertices.clear();
+    m_faceNormals.clear();
+    m_faceTexCoords.clear();
+    ObjFile::Face face(type);
     bool hasNormal = false;
 
     const int vSize = static_cast<unsigned int>(m_pModel->mVertices.size());
@@ -494,11 +498,11 @@ void ObjFileParser::getFace(aiPrimitiveType type) {
             if (iVal > 0) {
                 // Store parsed index
                 if (0 == iPos) {
-                    face->m_vertices.push_back(iVal - 1);
+                    m_faceVertices.push_back(iVal - 1);
                 } else if (1 == iPos) {
-                    face->m_texturCoords.push_back(iVal - 1);
+                    m_faceTexCoords.push_back(iVal - 1);
                 } else if (2 == iPos) {
-                    face->m_normals.push_back(iVal - 1);
+                    m_faceNormals.push_back(iVal - 1);
                     hasNormal = true;
                 } else {
                     reportErrorTokenInFace();
@@ -506,37 +510,35 @@ void ObjFileParser::getFace(aiPrimitiveType type) {
             } else if (iVal < 0) {
                 // Store relatively index
                 if (0 == iPos) {
-                    face->m_vertices.push_back(vSize + iVal);
+                    m_faceVertices.push_back(vSize + iVal);
                 } else if (1 == iPos) {
-                    face->m_texturCoords.push_back(vtSize + iVal);
+                    m_faceTexCoords.push_back(vtSize + iVal);
                 } else if (2 == iPos) {
-                    face->m_normals.push_back(vnSize + iVal);
+                    m_faceNormals.push_back(vnSize + iVal);
                     hasNormal = true;
                 } else {
                     reportErrorTokenInFace();
                 }
             } else {
                 //On error, std::atoi will return 0 which is not a valid value
-                delete face;
                 throw DeadlyImportError("OBJ: Invalid face index.");
             }
         }
         m_DataIt += iStep;
     }
 
-    if (face->m_vertices.empty()) {
+    if (m_faceVertices.empty()) {
         ASSIMP_LOG_ERROR("Obj: Ignoring empty face");
         // skip line and clean up
         m_DataIt = skipLine<DataArrayIt>(m_DataIt, m_DataItEnd, m_uiLine);
-        delete face;
         return;
     }
 
     // Set active material, if one set
     if (nullptr != m_pModel->mCurrentMaterial) {
-        face->m_pMaterial = m_pModel->mCurrentMaterial;
+        face.m_pMaterial = m_pModel->mCurrentMaterial;
     } else {
-        face->m_pMaterial = m_pModel->mDefaultMaterial;
+        face.m_pMaterial = m_pModel->mDefaultMaterial;
     }
 
     // Create a default object, if nothing is there
@@ -549,10 +551,20 @@ void ObjFileParser::getFace(aiPrimitiveType type) {
         createMesh(DefaultObjName);
     }
 
-    // Store the face
-    m_pModel->mCurrentMesh->m_Faces.emplace_back(face);
-    m_pModel->mCurrentMesh->m_uiNumIndices += static_cast<unsigned int>(face->m_vertices.size());
-    m_pModel->mCurrentMesh->m_uiUVCoordinates[0] += static_cast<unsigned int>(face->m_texturCoords.size());
+    // Store the face, its indices go into the mesh pools
+    ObjFile::Mesh *mesh = m_pModel->mCurrentMesh;
+    face.m_firstVertex = static_cast<unsigned int>(mesh->m_vertexIndices.size());
+    face.m_numVertices = static_cast<unsigned int>(m_faceVertices.size());
+    face.m_firstNormal = static_cast<unsigned int>(mesh->m_normalIndices.size());
+    face.m_numNormals = static_cast<unsigned int>(m_faceNormals.size());
+    face.m_firstTexCoord = static_cast<unsigned int>(mesh->m_texCoordIndices.size());
+    face.m_numTexCoords = static_cast<unsigned int>(m_faceTexCoords.size());
+    mesh->m_vertexIndices.insert(mesh->m_vertexIndices.end(), m_faceVertices.begin(), m_faceVertices.end());
+    mesh->m_normalIndices.insert(mesh->m_normalIndices.end(), m_faceNormals.begin(), m_faceNormals.end());
+    mesh->m_texCoordIndices.insert(mesh->m_texCoordIndices.end(), m_faceTexCoords.begin(), m_faceTexCoords.end());
+    mesh->m_Faces.push_back(face);
+    m_pModel->mCurrentMesh->m_uiNumIndices += face.m_numVertices;
+    m_pModel->mCurrentMesh->m_uiUVCoordinates[0] += face.m_numTexCoords;
     if (!m_pModel->mCurrentMesh->m_hasNormals && hasNormal) {
         m_pModel->mCurrentMesh->m_hasNormals = true;
     }
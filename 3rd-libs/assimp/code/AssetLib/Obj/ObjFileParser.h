@@ -150,6 +150,10 @@ private:
     ProgressHandler *m_progress;
     /// Path to the current model, name of the obj file where the buffer comes from
     const std::string m_originalObjFileName;
+    /// Scratch index arrays of the face being parsed, reused for every face
+    ObjFile::Face::IndexArray m_faceVertices;
+    ObjFile::Face::IndexArray m_faceNormals;
+    ObjFile::Face::IndexArray m_faceTexCoords;
 };
 
 } // Namespace Assimp
@@ -164,7 +164,8 @@ ai_real ImproveCacheLocalityProcess::ProcessMesh(aiMesh *pMesh, unsigned int mes
     if (!pMesh->HasFaces() || !pMesh->HasPositions())
         return static_cast<ai_real>(0.f);
 
-    if (pMesh->mPrimitiveTypes != aiPrimitiveType_TRIANGLE) {
+    // triangulated polygons carry the NGON encoding flag but are plain triangles here
+    if ((pMesh->mPrimitiveTypes & ~aiPrimitiveType_NGONEncodingFlag) != aiPrimitiveType_TRIANGLE) {
         ASSIMP_LOG_ERROR("This algorithm works on triangle meshes only");
         return static_cast<ai_real>(0.f);
     }
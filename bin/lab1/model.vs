@@ -0,0 +1,57 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in mat4 aInstanceModel; // ModelInstance, placed by model as a whole
+layout (location = 7) in mat3 aInstanceNormal; // inverse transpose of aInstanceModel, from the CPU
+
+out vec2 oTexCoords;
+out vec3 oNormal;
+out vec3 oCamPos;
+out vec3 oFragPos;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform mat4 NormalMatrix;
+uniform vec3 camPos;
+
+// packed meshes: unorm16 position inside the AABB, octahedral normal in aNormal.xy
+uniform int uPackedVertices;
+uniform vec3 uPositionOffset;
+uniform vec3 uPositionScale;
+
+uniform int uInstanced;
+// world matrix of the mesh's scene node and its normal matrix, under aInstanceModel
+uniform mat4 uNodeMatrix;
+uniform mat3 uNodeNormalMatrix;
+
+vec3 octDecode(vec2 e){
+    vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0f);
+    n.xy += vec2(n.x >= 0.0f ? -t : t, n.y >= 0.0f ? -t : t);
+    return normalize(n);
+}
+
+void main(){
+    vec3 pos = aPos;
+    vec3 normal = aNormal;
+    if (uPackedVertices != 0) {
+        pos = aPos * uPositionScale + uPositionOffset;
+        normal = octDecode(aNormal.xy);
+    }
+
+    mat4 world = model;
+    if (uInstanced != 0) {
+        world = model * aInstanceModel * uNodeMatrix;
+        oNormal = mat3(NormalMatrix) * (aInstanceNormal * (uNodeNormalMatrix * normal));
+    } else {
+        oNormal = (NormalMatrix * vec4(normal, 1.0f)).xyz;
+    }
+
+    oTexCoords = aTexCoords;
+    oFragPos = (world * vec4(pos, 1.0f)).xyz;
+    oCamPos = camPos;
+
+    gl_Position = projection * view * world * vec4(pos, 1.0f);
+}
\ No newline at end of file
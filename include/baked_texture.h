@@ -0,0 +1,213 @@
+#ifndef BAKED_TEXTURE_H
+#define BAKED_TEXTURE_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hash.h"
+#include "mapped_file.h"
+#include "stb_image.h"
+
+// pre-baked texture stored next to the source image, e.g. creeper.png.ltex
+// layout: header | level table | level 0 .. level N-1, tightly packed rows (unpack alignment 1)
+// the whole mip chain is baked once, so loads skip both stbi and glGenerateMipmap
+
+const std::string BAKED_TEXTURE_EXTENSION = ".ltex";
+constexpr uint32_t BAKED_TEXTURE_MAGIC = 0x5845544c; // "LTEX"
+constexpr uint32_t BAKED_TEXTURE_VERSION = 1;
+
+struct BakedTextureHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceHash; // hash of the encoded source image
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t levelCount;
+};
+
+struct BakedTextureLevel {
+    uint64_t offset;
+    uint64_t size;
+    uint32_t width;
+    uint32_t height;
+};
+
+GLenum formatFromChannels(int channels) {
+    if (channels == 1) {
+        return GL_RED;
+    } else if (channels == 2) {
+        return GL_RG;
+    } else if (channels == 4) {
+        return GL_RGBA;
+    }
+    return GL_RGB;
+}
+
+class BakedTexture {
+public:
+    // map a baked file, fails if it is missing, corrupt or older than the source
+    bool open(const std::string& path, uint64_t sourceHash);
+
+    const BakedTextureHeader& header() const { return *mHeader; }
+    const BakedTextureLevel& level(unsigned i) const { return mLevels[i]; }
+    const unsigned char* levelData(unsigned i) const { return mFile.data() + mLevels[i].offset; }
+
+    // upload every level into the texture bound to GL_TEXTURE_2D, straight from the mapping
+    void upload() const;
+private:
+    MappedFile mFile;
+    const BakedTextureHeader* mHeader = nullptr;
+    const BakedTextureLevel* mLevels = nullptr;
+};
+
+// build the full mip chain of decoded pixels and write it to path
+bool bakeTexture(const unsigned char* pixels, int width, int height, int channels, uint64_t sourceHash, const std::string& path);
+
+// open <sourcePath>.ltex, baking it from the source image first when it is missing or stale
+bool loadBakedTexture(const std::string& sourcePath, BakedTexture& baked);
+
+bool BakedTexture::open(const std::string& path, uint64_t sourceHash) {
+    mHeader = nullptr;
+    mLevels = nullptr;
+    if (!mFile.open(path) || mFile.size() < sizeof(BakedTextureHeader)) {
+        return false;
+    }
+
+    auto header = reinterpret_cast<const BakedTextureHeader*>(mFile.data());
+    uint64_t tableEnd = sizeof(BakedTextureHeader) + uint64_t(header->levelCount) * sizeof(BakedTextureLevel);
+    // a 32-bit edge halves down to 1 within 32 levels
+    if (header->magic != BAKED_TEXTURE_MAGIC || header->version != BAKED_TEXTURE_VERSION || header->sourceHash != sourceHash
+        || header->levelCount == 0 || header->levelCount > 32 || header->channels == 0 || header->channels > 4
+        || header->width == 0 || header->height == 0 || tableEnd > mFile.size()) {
+        mFile.close();
+        return false;
+    }
+
+    auto levels = reinterpret_cast<const BakedTextureLevel*>(mFile.data() + sizeof(BakedTextureHeader));
+    for (unsigned i{}; i < header->levelCount; i ++) {
+        // each level halves the one above it, the same chain bakeTexture writes
+        uint32_t width = std::max(header->width >> i, 1u), height = std::max(header->height >> i, 1u);
+        if (!cacheSectionFits(levels[i].offset, levels[i].size, 1, mFile.size())
+            || levels[i].width != width || levels[i].height != height
+            || levels[i].size != uint64_t(width) * height * header->channels) {
+            mFile.close();
+            return false;
+        }
+    }
+
+    mHeader = header;
+    mLevels = levels;
+    return true;
+}
+
+void BakedTexture::upload() const {
+    GLenum format = formatFromChannels(mHeader->channels);
+
+    GLint alignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // GL 3.3 has no immutable storage (glTexStorage2D), so each level is specified on its own
+    // and the sampled range is pinned with BASE/MAX_LEVEL to keep the texture complete
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mHeader->levelCount - 1);
+    for (unsigned i{}; i < mHeader->levelCount; i ++) {
+        glTexImage2D(GL_TEXTURE_2D, i, format, mLevels[i].width, mLevels[i].height, 0, format, GL_UNSIGNED_BYTE, levelData(i));
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+}
+
+bool bakeTexture(const unsigned char* pixels, int width, int height, int channels, uint64_t sourceHash, const std::string& path) {
+    // 2x2 box filter down to 1x1, odd edges reuse the last row/column
+    std::vector<std::vector<unsigned char>> chain;
+    std::vector<BakedTextureLevel> levels;
+    chain.emplace_back(pixels, pixels + size_t(width) * height * channels);
+    levels.push_back({0, chain.back().size(), uint32_t(width), uint32_t(height)});
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        auto& src = chain.back();
+        int srcWidth = levels.back().width, srcHeight = levels.back().height;
+        int dstWidth = std::max(srcWidth / 2, 1), dstHeight = std::max(srcHeight / 2, 1);
+        std::vector<unsigned char> dst(size_t(dstWidth) * dstHeight * channels);
+        for (int y{}; y < dstHeight; y ++) {
+            int y0 = std::min(y * 2, srcHeight - 1), y1 = std::min(y * 2 + 1, srcHeight - 1);
+            for (int x{}; x < dstWidth; x ++) {
+                int x0 = std::min(x * 2, srcWidth - 1), x1 = std::min(x * 2 + 1, srcWidth - 1);
+                for (int c{}; c < channels; c ++) {
+                    unsigned sum = src[(size_t(y0) * srcWidth + x0) * channels + c] + src[(size_t(y0) * srcWidth + x1) * channels + c]
+                                 + src[(size_t(y1) * srcWidth + x0) * channels + c] + src[(size_t(y1) * srcWidth + x1) * channels + c];
+                    dst[(size_t(y) * dstWidth + x) * channels + c] = static_cast<unsigned char>((sum + 2) / 4);
+                }
+            }
+        }
+        levels.push_back({0, dst.size(), uint32_t(dstWidth), uint32_t(dstHeight)});
+        chain.push_back(std::move(dst));
+    }
+
+    uint64_t offset = sizeof(BakedTextureHeader) + levels.size() * sizeof(BakedTextureLevel);
+    for (auto& level : levels) {
+        offset = (offset + 7) & ~uint64_t(7);
+        level.offset = offset;
+        offset += level.size;
+    }
+
+    BakedTextureHeader header{BAKED_TEXTURE_MAGIC, BAKED_TEXTURE_VERSION, sourceHash,
+        uint32_t(width), uint32_t(height), uint32_t(channels), uint32_t(levels.size())};
+
+    // one temporary per thread: pool workers may bake the same image at once (other sampler, other model)
+    std::string tmpPath = path + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(levels.data()), static_cast<std::streamsize>(levels.size() * sizeof(BakedTextureLevel)));
+    for (size_t i{}; i < levels.size(); i ++) {
+        static const char zeros[8]{};
+        file.write(zeros, static_cast<std::streamsize>(levels[i].offset - static_cast<uint64_t>(file.tellp())));
+        file.write(reinterpret_cast<const char*>(chain[i].data()), static_cast<std::streamsize>(chain[i].size()));
+    }
+    file.close();
+    if (!file) {
+        std::filesystem::remove(tmpPath);
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    return !ec;
+}
+
+bool loadBakedTexture(const std::string& sourcePath, BakedTexture& baked) {
+    MappedFile source(sourcePath);
+    if (!source.isOpen()) {
+        return false;
+    }
+    uint64_t sourceHash = hashBytes(source.data(), source.size());
+    std::string bakedPath = sourcePath + BAKED_TEXTURE_EXTENSION;
+    if (baked.open(bakedPath, sourceHash)) {
+        return true;
+    }
+
+    // cache miss: decode once and bake the whole chain
+    int width, height, nrComponents;
+    unsigned char* data = stbi_load_from_memory(source.data(), static_cast<int>(source.size()), &width, &height, &nrComponents, 0);
+    if (!data) {
+        return false;
+    }
+    bool written = bakeTexture(data, width, height, nrComponents, sourceHash, bakedPath);
+    stbi_image_free(data);
+    return written && baked.open(bakedPath, sourceHash);
+}
+
+#endif // BAKED_TEXTURE_H
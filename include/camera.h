@@ -7,6 +7,8 @@
 
 #include <glad/glad.h>
 
+#include "culling.h"
+
 enum class CAMERA_MOVEMENT {
     FORWARD,
     BACKWARD,
@@ -20,6 +22,8 @@ const float PITCH = 0.0f;
 const float SPEED = 2.5f;
 const float SENSITIVITY = 0.1f;
 const float FOV_zoom = 45.0f;
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
 
 class Camera {
 public:
@@ -38,6 +42,9 @@ public:
     float movementSpeed = SPEED;
     float mouseSensitivity = SENSITIVITY;
     float fov_zoom = FOV_zoom;
+    float aspect = 1.0f;        // viewport width / height, keep in sync with the window
+    float nearPlane = NEAR_PLANE;
+    float farPlane = FAR_PLANE;
 
     // constructor with vectors
     Camera(glm::vec3 = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 = glm::vec3(0.0f, 1.0f, 0.0f), float = YAW, float = PITCH);
@@ -45,7 +52,14 @@ public:
     Camera(float, float, float, float, float, float, float, float);
 
     // return view matrix calculated using Euler angles and LookAt matrix
-    glm::mat4 getViewMatrix();
+    glm::mat4 getViewMatrix() const;
+    // perspective projection from fov_zoom, aspect and the clip planes
+    glm::mat4 getProjectionMatrix() const;
+    // world-space view frustum of projection * view
+    Frustum frustum() const;
+
+    // fraction of the viewport height covered by a world-space sphere, 1 or more when the camera is inside it
+    float screenFraction(const glm::vec3&, float) const;
 
     // process input received from any keyboard-like input system
     void processKeyboard(CAMERA_MOVEMENT, float);
@@ -88,10 +102,26 @@ void Camera::updateCameraVectors() {
     up = glm::normalize(glm::cross(right, front));
 }
 
-glm::mat4 Camera::getViewMatrix() {
+float Camera::screenFraction(const glm::vec3& center, float radius) const {
+    float distance = glm::length(center - position);
+    if (distance <= radius) {
+        return 1.0f;
+    }
+    return radius / (distance * std::tan(glm::radians(fov_zoom) * 0.5f));
+}
+
+glm::mat4 Camera::getViewMatrix() const {
     return glm::lookAt(position, position + front, up);
 }
 
+glm::mat4 Camera::getProjectionMatrix() const {
+    return glm::perspective(glm::radians(fov_zoom), aspect, nearPlane, farPlane);
+}
+
+Frustum Camera::frustum() const {
+    return Frustum::fromMatrix(getProjectionMatrix() * getViewMatrix());
+}
+
 void Camera::processKeyboard(CAMERA_MOVEMENT POSITION, float deltaFrame) {
     float velocity = movementSpeed * deltaFrame;
     switch (POSITION) {
@@ -0,0 +1,152 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <glm/glm.hpp>
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "simd.h"
+
+// view frustum as six inward-facing planes (xyz normal, w offset), normalized so
+// dot(plane.xyz, p) + plane.w is the signed distance of p
+struct Frustum {
+    glm::vec4 planes[6]; // left, right, bottom, top, near, far
+
+    // planes of clip = matrix * p; pass projection * view for world space,
+    // projection * view * model to get them in the model's object space
+    static Frustum fromMatrix(const glm::mat4& matrix);
+
+    bool sphereVisible(const glm::vec3& center, float radius) const;
+    bool boxVisible(const glm::vec3& center, const glm::vec3& extent) const;
+};
+
+// axis-aligned boxes (center and half extent) as structure of arrays; the lanes are kept
+// padded to a multiple of 8 and only the first count() entries are real
+class BoxSet {
+public:
+    std::vector<float> centerX, centerY, centerZ, extentX, extentY, extentZ;
+
+    size_t count() const { return size; }
+    bool empty() const { return size == 0; }
+    void clear();
+    void push(const glm::vec3& center, const glm::vec3& extent);
+    // the box enclosing a local box moved by transform
+    void push(const glm::vec3& center, const glm::vec3& extent, const glm::mat4& transform);
+private:
+    size_t size = 0;
+};
+
+// indices of the boxes that intersect the frustum, in the frustum's space, SIMD_WIDTH boxes at a time
+void cullBoxes(const BoxSet& boxes, const Frustum& frustum, std::vector<uint32_t>& visible);
+
+Frustum Frustum::fromMatrix(const glm::mat4& m) {
+    // Gribb/Hartmann: rows of the matrix combined with the w row
+    glm::vec4 row[4];
+    for (int i{}; i < 4; i ++) {
+        row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+    }
+    Frustum frustum;
+    frustum.planes[0] = row[3] + row[0];
+    frustum.planes[1] = row[3] - row[0];
+    frustum.planes[2] = row[3] + row[1];
+    frustum.planes[3] = row[3] - row[1];
+    frustum.planes[4] = row[3] + row[2];
+    frustum.planes[5] = row[3] - row[2];
+    for (auto& plane : frustum.planes) {
+        float length = glm::length(glm::vec3(plane));
+        if (length > 0.0f) {
+            plane /= length;
+        }
+    }
+    return frustum;
+}
+
+bool Frustum::sphereVisible(const glm::vec3& center, float radius) const {
+    for (auto& plane : planes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Frustum::boxVisible(const glm::vec3& center, const glm::vec3& extent) const {
+    for (auto& plane : planes) {
+        // the box's projected radius on the plane normal
+        float radius = std::abs(plane.x) * extent.x + std::abs(plane.y) * extent.y + std::abs(plane.z) * extent.z;
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BoxSet::clear() {
+    size = 0;
+    for (auto* lane : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ}) {
+        lane->clear();
+    }
+}
+
+void BoxSet::push(const glm::vec3& center, const glm::vec3& extent) {
+    if (size == centerX.size()) {
+        for (auto* lane : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ}) {
+            lane->resize(size + 8, 0.0f);
+        }
+    }
+    centerX[size] = center.x;
+    centerY[size] = center.y;
+    centerZ[size] = center.z;
+    extentX[size] = extent.x;
+    extentY[size] = extent.y;
+    extentZ[size] = extent.z;
+    size ++;
+}
+
+void BoxSet::push(const glm::vec3& center, const glm::vec3& extent, const glm::mat4& transform) {
+    // Arvo: the new half extent sums the absolute matrix columns scaled by the old one
+    glm::vec3 movedExtent = glm::abs(glm::vec3(transform[0])) * extent.x
+        + glm::abs(glm::vec3(transform[1])) * extent.y + glm::abs(glm::vec3(transform[2])) * extent.z;
+    push(glm::vec3(transform * glm::vec4(center, 1.0f)), movedExtent);
+}
+
+void cullBoxes(const BoxSet& boxes, const Frustum& frustum, std::vector<uint32_t>& visible) {
+    visible.clear();
+    size_t count = boxes.count();
+    SimdFloat planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+    for (int p{}; p < 6; p ++) {
+        auto& plane = frustum.planes[p];
+        planeX[p] = simdSet(plane.x);
+        planeY[p] = simdSet(plane.y);
+        planeZ[p] = simdSet(plane.z);
+        planeW[p] = simdSet(plane.w);
+        absX[p] = simdSet(std::abs(plane.x));
+        absY[p] = simdSet(std::abs(plane.y));
+        absZ[p] = simdSet(std::abs(plane.z));
+    }
+    SimdFloat zero = simdSet(0.0f);
+    for (size_t i{}; i < count; i += SIMD_WIDTH) {
+        SimdFloat cx = simdLoad(&boxes.centerX[i]), cy = simdLoad(&boxes.centerY[i]), cz = simdLoad(&boxes.centerZ[i]);
+        SimdFloat ex = simdLoad(&boxes.extentX[i]), ey = simdLoad(&boxes.extentY[i]), ez = simdLoad(&boxes.extentZ[i]);
+        unsigned mask = (1u << SIMD_WIDTH) - 1;
+        for (int p{}; p < 6 && mask; p ++) {
+            // signed distance of the center plus the box's reach towards the plane;
+            // most boxes fail one of the first planes, so stop once the whole batch is out
+            SimdFloat distance = planeX[p] * cx + planeY[p] * cy + planeZ[p] * cz + planeW[p]
+                + absX[p] * ex + absY[p] * ey + absZ[p] * ez;
+            mask &= simdMask(simdGreaterEqual(distance, zero));
+        }
+        while (mask) {
+            unsigned lane = static_cast<unsigned>(std::countr_zero(mask));
+            mask &= mask - 1;
+            if (i + lane < count) {
+                visible.push_back(static_cast<uint32_t>(i + lane));
+            }
+        }
+    }
+}
+
+#endif // CULLING_H
@@ -0,0 +1,265 @@
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "imgui.h"
+#include "render_stats.h"
+#include "trace.h"
+
+// per-pass CPU and GPU time of the frame loop, shown by drawPanel() in the ImGui overlay
+// GPU time comes from GL_TIME_ELAPSED queries kept in a ring per pass; results are collected
+// only once GL_QUERY_RESULT_AVAILABLE says so, a few frames late, so nothing ever waits on the GPU
+// passes may not nest, there is one GL_TIME_ELAPSED query active at a time
+
+// frames of history behind the graphs and percentiles
+constexpr size_t PROFILER_HISTORY = 240;
+// queries in flight per pass, a pass whose oldest one is still pending skips its GPU sample
+constexpr size_t PROFILER_QUERY_FRAMES = 4;
+
+// rolling window of the last PROFILER_HISTORY samples
+struct ProfilerSeries {
+    std::array<float, PROFILER_HISTORY> values{};
+    size_t count = 0; // samples ever pushed
+
+    void push(float value) { values[count ++ % PROFILER_HISTORY] = value; }
+    size_t size() const { return std::min(count, PROFILER_HISTORY); }
+    float last() const { return count ? values[(count - 1) % PROFILER_HISTORY] : 0.0f; }
+    // oldest sample first, the layout ImGui::PlotLines wants with this offset
+    int plotOffset() const { return count < PROFILER_HISTORY ? 0 : static_cast<int>(count % PROFILER_HISTORY); }
+    float mean() const;
+    // nearest rank over the window, p in [0, 100]
+    float percentile(float p) const;
+};
+
+class FrameProfiler {
+public:
+    FrameProfiler() = default;
+    // deletes the queries, so it must run before glfwTerminate()
+    ~FrameProfiler();
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+    void beginFrame();
+    // collects whatever query results have arrived, never blocks
+    void endFrame();
+
+    // name must be a string literal, the pass is found by pointer after the first frame
+    void beginPass(const char* name);
+    void endPass();
+    // draws issued around renderStats, e.g. by ImGui's backend, charged to the open pass
+    void addDraws(uint64_t drawCalls, uint64_t triangles);
+
+    void drawPanel();
+private:
+    struct Pass {
+        const char* name;
+        std::array<GLuint, PROFILER_QUERY_FRAMES> queries{};
+        std::array<bool, PROFILER_QUERY_FRAMES> pending{};
+        size_t issued = 0; // queries ever begun, the next slot is issued % PROFILER_QUERY_FRAMES
+        size_t collected = 0;
+        ProfilerSeries cpu, gpu; // milliseconds
+        uint64_t drawCalls = 0, triangles = 0; // last frame
+        std::chrono::steady_clock::time_point begin;
+        RenderStats statsBegin;
+        bool queryOpen = false;
+    };
+    std::vector<Pass> passes;
+    Pass* open = nullptr;
+    ProfilerSeries frameCpu;
+    std::chrono::steady_clock::time_point frameBegin;
+    uint64_t skippedQueries = 0;
+
+    Pass& pass(const char* name);
+    void collect(Pass& pass);
+};
+
+// beginPass/endPass for a block, also recorded as a trace scope of the same name
+class ProfileScope {
+public:
+    ProfileScope(FrameProfiler& profiler, const char* name): profiler(&profiler), trace(name) { profiler.beginPass(name); }
+    ~ProfileScope() { end(); }
+    void end() {
+        if (profiler) {
+            profiler->endPass();
+            trace.end();
+            profiler = nullptr;
+        }
+    }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+private:
+    FrameProfiler* profiler;
+    TraceScope trace;
+};
+
+float ProfilerSeries::mean() const {
+    size_t n = size();
+    float sum = 0.0f;
+    for (size_t i{}; i < n; i ++) {
+        sum += values[i];
+    }
+    return n ? sum / n : 0.0f;
+}
+
+float ProfilerSeries::percentile(float p) const {
+    size_t n = size();
+    if (n == 0) {
+        return 0.0f;
+    }
+    std::array<float, PROFILER_HISTORY> sorted;
+    std::copy_n(values.begin(), n, sorted.begin());
+    size_t rank = std::clamp<size_t>(static_cast<size_t>(p / 100.0f * n + 0.999f), 1, n) - 1;
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.begin() + n);
+    return sorted[rank];
+}
+
+FrameProfiler::~FrameProfiler() {
+    // no passes, no queries: a profiler that never ran has no reason to ask GLFW
+    if (passes.empty() || !glfwGetCurrentContext()) {
+        return;
+    }
+    for (auto& pass : passes) {
+        glDeleteQueries(PROFILER_QUERY_FRAMES, pass.queries.data());
+    }
+}
+
+FrameProfiler::Pass& FrameProfiler::pass(const char* name) {
+    for (auto& pass : passes) {
+        if (pass.name == name || std::strcmp(pass.name, name) == 0) {
+            return pass;
+        }
+    }
+    auto& pass = passes.emplace_back();
+    pass.name = name;
+    glGenQueries(PROFILER_QUERY_FRAMES, pass.queries.data());
+    return pass;
+}
+
+void FrameProfiler::beginFrame() {
+    frameBegin = std::chrono::steady_clock::now();
+}
+
+void FrameProfiler::endFrame() {
+    frameCpu.push(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameBegin).count());
+    for (auto& pass : passes) {
+        collect(pass);
+    }
+}
+
+void FrameProfiler::collect(Pass& pass) {
+    // in issue order, a later query is never ready before an earlier one
+    while (pass.collected < pass.issued) {
+        size_t slot = pass.collected % PROFILER_QUERY_FRAMES;
+        if (pass.pending[slot]) {
+            GLint available = 0;
+            glGetQueryObjectiv(pass.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                return;
+            }
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(pass.queries[slot], GL_QUERY_RESULT, &nanoseconds);
+            pass.gpu.push(static_cast<float>(nanoseconds * 1e-6));
+            pass.pending[slot] = false;
+        }
+        pass.collected ++;
+    }
+}
+
+void FrameProfiler::beginPass(const char* name) {
+    auto& current = pass(name);
+    open = &current;
+    current.begin = std::chrono::steady_clock::now();
+    current.statsBegin = renderStats;
+    current.drawCalls = current.triangles = 0;
+
+    size_t slot = current.issued % PROFILER_QUERY_FRAMES;
+    if (current.pending[slot]) {
+        // the GPU is PROFILER_QUERY_FRAMES frames behind, reusing the query would stall
+        collect(current);
+    }
+    current.queryOpen = !current.pending[slot];
+    if (current.queryOpen) {
+        glBeginQuery(GL_TIME_ELAPSED, current.queries[slot]);
+    } else {
+        skippedQueries ++;
+    }
+}
+
+void FrameProfiler::endPass() {
+    if (!open) {
+        return;
+    }
+    auto& current = *open;
+    if (current.queryOpen) {
+        glEndQuery(GL_TIME_ELAPSED);
+        current.pending[current.issued % PROFILER_QUERY_FRAMES] = true;
+        current.issued ++;
+        current.queryOpen = false;
+    }
+    current.cpu.push(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - current.begin).count());
+    current.drawCalls += renderStats.drawCalls - current.statsBegin.drawCalls;
+    current.triangles += renderStats.triangles - current.statsBegin.triangles;
+    open = nullptr;
+}
+
+void FrameProfiler::addDraws(uint64_t drawCalls, uint64_t triangles) {
+    if (open) {
+        open->drawCalls += drawCalls;
+        open->triangles += triangles;
+    }
+}
+
+void FrameProfiler::drawPanel() {
+    if (!ImGui::CollapsingHeader("Profiler", ImGuiTreeNodeFlags_DefaultOpen)) {
+        return;
+    }
+    ImGui::Text("frame CPU %.2f ms  p50 %.2f  p95 %.2f  p99 %.2f  max %.2f", frameCpu.last(),
+        frameCpu.percentile(50.0f), frameCpu.percentile(95.0f), frameCpu.percentile(99.0f), frameCpu.percentile(100.0f));
+    ImGui::PlotLines("##frame", frameCpu.values.data(), static_cast<int>(frameCpu.size()), frameCpu.plotOffset(),
+        "frame CPU ms", 0.0f, std::max(frameCpu.percentile(100.0f), 16.7f), ImVec2(0.0f, 60.0f));
+
+    if (ImGui::BeginTable("passes", 8, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+        for (const char* column : {"pass", "CPU ms", "CPU p95", "CPU p99", "GPU ms", "GPU p95", "GPU p99", "draws / tris"}) {
+            ImGui::TableSetupColumn(column);
+        }
+        ImGui::TableHeadersRow();
+        for (auto& pass : passes) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::TextUnformatted(pass.name);
+            ImGui::TableNextColumn(); ImGui::Text("%.3f", pass.cpu.mean());
+            ImGui::TableNextColumn(); ImGui::Text("%.3f", pass.cpu.percentile(95.0f));
+            ImGui::TableNextColumn(); ImGui::Text("%.3f", pass.cpu.percentile(99.0f));
+            ImGui::TableNextColumn(); ImGui::Text("%.3f", pass.gpu.mean());
+            ImGui::TableNextColumn(); ImGui::Text("%.3f", pass.gpu.percentile(95.0f));
+            ImGui::TableNextColumn(); ImGui::Text("%.3f", pass.gpu.percentile(99.0f));
+            ImGui::TableNextColumn(); ImGui::Text("%llu / %llu", static_cast<unsigned long long>(pass.drawCalls), static_cast<unsigned long long>(pass.triangles));
+        }
+        ImGui::EndTable();
+    }
+    // CPU left, GPU right, both on the pass's own scale
+    float width = (ImGui::GetContentRegionAvail().x - ImGui::GetStyle().ItemSpacing.x) * 0.5f;
+    for (auto& pass : passes) {
+        ImGui::PushID(pass.name);
+        float scale = std::max({pass.cpu.percentile(100.0f), pass.gpu.percentile(100.0f), 1.0f});
+        ImGui::PlotLines("##cpu", pass.cpu.values.data(), static_cast<int>(pass.cpu.size()), pass.cpu.plotOffset(),
+            pass.name, 0.0f, scale, ImVec2(width, 40.0f));
+        ImGui::SameLine();
+        ImGui::PlotLines("##gpu", pass.gpu.values.data(), static_cast<int>(pass.gpu.size()), pass.gpu.plotOffset(),
+            "GPU", 0.0f, scale, ImVec2(width, 40.0f));
+        ImGui::PopID();
+    }
+    if (skippedQueries) {
+        ImGui::Text("GPU samples skipped (queries still pending): %llu", static_cast<unsigned long long>(skippedQueries));
+    }
+}
+
+#endif // FRAME_PROFILER_H
@@ -0,0 +1,29 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+constexpr uint64_t HASH_SEED = 0xcbf29ce484222325ull;
+
+// 64-bit hash over 8-byte words with an FNV-1a tail, chain calls by passing the previous result as seed
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = HASH_SEED) {
+    auto bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    size_t i{};
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, 8);
+        hash ^= word;
+        hash *= 0x9e3779b97f4a7c15ull;
+        hash ^= hash >> 32;
+    }
+    for (; i < size; i ++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+#endif // HASH_H
@@ -10,6 +10,7 @@
 #include "shader_s.h"
 #include "camera.h"
 #include "model.h"
+#include "model_instance.h"
 #include "filesystem.h"
 #include "light.h"
 
@@ -24,4 +25,6 @@
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
-#include "imgui_impl_opengl3.h"
\ No newline at end of file
+#include "imgui_impl_opengl3.h"
+
+#include "frame_profiler.h"
\ No newline at end of file
@@ -0,0 +1,137 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// read-only mapping of a whole file, unmapped on destruction
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path) { open(path); }
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept { swap(other); }
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        close();
+        swap(other);
+        return *this;
+    }
+
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return mData != nullptr; }
+    const unsigned char* data() const { return mData; }
+    size_t size() const { return mSize; }
+private:
+    const unsigned char* mData = nullptr;
+    size_t mSize = 0;
+#ifdef _WIN32
+    HANDLE mFile = INVALID_HANDLE_VALUE;
+    HANDLE mMapping = nullptr;
+#endif
+    void swap(MappedFile& other) noexcept;
+};
+
+// count elements of elemSize starting at offset lie inside a file of fileSize bytes, without overflowing
+bool cacheSectionFits(uint64_t offset, uint64_t count, uint64_t elemSize, uint64_t fileSize) {
+    return offset <= fileSize && count <= (fileSize - offset) / elemSize;
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+#ifdef _WIN32
+    mFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (mFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(mFile, &fileSize) || fileSize.QuadPart == 0) {
+        close();
+        return false;
+    }
+    mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mMapping) {
+        close();
+        return false;
+    }
+    mData = static_cast<const unsigned char*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+    mSize = mData ? static_cast<size_t>(fileSize.QuadPart) : 0;
+    if (!mData) {
+        close();
+        return false;
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    // the mapping keeps its own reference to the file
+    void* ptr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED) {
+        return false;
+    }
+    mData = static_cast<const unsigned char*>(ptr);
+    mSize = static_cast<size_t>(st.st_size);
+#endif
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (mData) {
+        UnmapViewOfFile(mData);
+    }
+    if (mMapping) {
+        CloseHandle(mMapping);
+    }
+    if (mFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(mFile);
+    }
+    mMapping = nullptr;
+    mFile = INVALID_HANDLE_VALUE;
+#else
+    if (mData) {
+        munmap(const_cast<unsigned char*>(mData), mSize);
+    }
+#endif
+    mData = nullptr;
+    mSize = 0;
+}
+
+void MappedFile::swap(MappedFile& other) noexcept {
+    std::swap(mData, other.mData);
+    std::swap(mSize, other.mSize);
+#ifdef _WIN32
+    std::swap(mFile, other.mFile);
+    std::swap(mMapping, other.mMapping);
+#endif
+}
+
+#endif // MAPPED_FILE_H
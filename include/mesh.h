@@ -3,12 +3,42 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
 #include <shader_s.h>
+#include "render_stats.h"
+#include "texture_cache.h"
 
 constexpr int MAX_BONE_INFLUNCE = 4;
+// first of the four vec4 locations holding the per-instance model matrix
+constexpr unsigned INSTANCE_MATRIX_LOCATION = 3;
+// then the three vec3 columns of its normal matrix
+constexpr unsigned INSTANCE_NORMAL_LOCATION = 7;
+
+// one element of the buffer DrawInstanced reads; the normal matrix is the inverse transpose of
+// the model matrix, computed once per instance here rather than per vertex in the shader
+struct InstanceData {
+    glm::mat4 model;
+    glm::mat3 normal;
+
+    InstanceData() = default;
+    explicit InstanceData(const glm::mat4& model): model(model), normal(glm::transpose(glm::inverse(glm::mat3(model)))) {}
+};
+
+// point the instance attributes of the bound VAO at buffer (InstanceData elements), and switch
+// them off again afterwards since the VAO is shared with plain draws
+void enableInstanceAttributes(unsigned buffer);
+void disableInstanceAttributes();
+// the model and NormalMatrix uniforms of plain draws
+void setModelMatrix(Shader& shader, const glm::mat4& model);
+// the node world matrix of the mesh drawn next by DrawInstanced, applied before the instance matrix
+void setNodeMatrix(Shader& shader, const glm::mat4& node);
 
 struct Vertex {
     glm::vec3 Position;
@@ -24,10 +54,35 @@ struct Vertex {
     // glm::vec4 diffuseColor;
 };
 
+// layout of the GPU copy, the CPU copy is always Vertex
+enum class VertexFormat {
+    Float,  // Vertex as is, 32 bytes
+    Packed, // PackedVertex, 16 bytes, decoded in model.vs
+};
+
+// position as unorm16 inside the mesh AABB, normal octahedral snorm16, texcoord half floats
+struct PackedVertex {
+    uint16_t Position[4]; // w is padding, keeps the normal 4-byte aligned
+    int16_t Normal[2];
+    uint16_t TexCoord[2];
+};
+
+// object space position = unorm position * scale + offset
+struct VertexQuantization {
+    glm::vec3 offset{0.0f};
+    glm::vec3 scale{1.0f};
+};
+
+// octahedral mapping of a unit vector to [-1, 1]^2
+glm::vec2 octEncode(glm::vec3 n);
+VertexQuantization packVertices(const Vertex* vertices, size_t count, std::vector<PackedVertex>& packed);
+
 struct Texture {
-    unsigned id;
+    TextureHandle handle; // shared through TextureCache
     std::string type;
     std::string path;
+
+    unsigned id() const { return handle ? handle->id : 0; }
 };
 
 struct Material {
@@ -36,26 +91,152 @@ struct Material {
     glm::vec3 mSpecular;
 };
 
+// texture that is referenced but not loaded yet, resolved to a GL id on the context thread
+struct TextureRef {
+    std::string type;
+    std::string path;
+};
+
+// one level of detail: a range of the index buffer over the shared vertex buffer
+struct MeshLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error; // object-space deviation from the full mesh
+};
+
+// CPU-side mesh produced by the conversion stage, no GL objects yet
+struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned> indices; // every LOD, back to back
+    std::vector<TextureRef> textures;
+    Material material;
+    std::vector<MeshLod> lods; // empty means a single level over all indices
+    uint32_t node = 0;         // scene graph node the mesh hangs under
+};
+
 class Mesh {
 public:
     std::vector<Vertex> vertices;
     std::vector<unsigned> indices;
     std::vector<Texture> textures;
     Material materials;
+    std::vector<MeshLod> lods;    // at least one level, the first is the full mesh
+    glm::vec3 boundsCenter;       // box around the vertices for culling
+    glm::vec3 boundsExtent;       // and the sphere around that box for LOD selection
+    float boundsRadius;
+
+    // createBuffers false leaves the GL buffers out (VAO stays 0), for meshes a MeshArena draws
+    Mesh(std::vector<Vertex>, std::vector<unsigned>, std::vector<Texture>, Material, VertexFormat = VertexFormat::Float, bool createBuffers = true);
+    // upload straight from external storage (e.g. a mapped mesh cache), the CPU copy is left empty
+    Mesh(const Vertex*, size_t, const unsigned*, size_t, std::vector<Texture>, Material, VertexFormat = VertexFormat::Float, bool createBuffers = true);
+    // owns GL objects, move only
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+    Mesh(Mesh&&) = default;
+    Mesh& operator=(Mesh&&) = default;
 
-    Mesh(std::vector<Vertex>, std::vector<unsigned>, std::vector<Texture>, Material);
-    void Draw(Shader&);
+    void Draw(Shader&, unsigned lod = 0);
+    // several index ranges of the buffer in one glMultiDrawElements, e.g. the visible meshlets
+    void DrawRanges(Shader&, const GLsizei* counts, const uint32_t* firstIndices, GLsizei drawCount);
+    // one draw for instanceCount copies, read from instanceBuffer (InstanceData per instance),
+    // under the node matrix set with setNodeMatrix()
+    void DrawInstanced(Shader&, unsigned instanceBuffer, GLsizei instanceCount);
+    // textures and material colors only, for draws that go through other buffers (MeshArena)
+    void bindMaterial(Shader&);
+    // delete the VAO/VBO/EBO once the geometry is drawn from elsewhere
+    void releaseBuffers();
+    // free the CPU copy of vertices/indices, drawing only needs the GL buffers
+    void releaseGeometry();
+    bool hasGeometry() const { return indices.size() == indexCount; }
 private:
     unsigned VAO, VBO, EBO;
-    void setupMesh();
+    unsigned indexCount;
+    GLenum indexType;
+    VertexFormat format;
+    VertexQuantization quantization;
+    void setupMesh(const Vertex*, size_t, const unsigned*, size_t, bool createBuffers);
+    void bindVertexFormat(Shader&);
 };
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned> indices, std::vector<Texture> textures, Material materials)
-    : vertices(vertices), indices(indices), textures(textures), materials(materials) {
-    setupMesh();
+glm::vec2 octEncode(glm::vec3 n) {
+    n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    glm::vec2 e(n.x, n.y);
+    if (n.z < 0.0f) {
+        // fold the lower hemisphere over the diagonals
+        e = (1.0f - glm::abs(glm::vec2(e.y, e.x))) * glm::vec2(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return e;
+}
+
+VertexQuantization packVertices(const Vertex* vertices, size_t count, std::vector<PackedVertex>& packed) {
+    VertexQuantization quantization;
+    packed.resize(count);
+    if (count == 0) {
+        return quantization;
+    }
+    glm::vec3 lower = vertices[0].Position, upper = vertices[0].Position;
+    for (size_t i = 1; i < count; i ++) {
+        lower = glm::min(lower, vertices[i].Position);
+        upper = glm::max(upper, vertices[i].Position);
+    }
+    quantization.offset = lower;
+    quantization.scale = upper - lower;
+    // flat axes keep scale 0, every vertex decodes to the offset there
+    glm::vec3 inverse = glm::vec3(65535.0f) / glm::max(quantization.scale, glm::vec3(1e-30f));
+
+    for (size_t i{}; i < count; i ++) {
+        const Vertex& vertex = vertices[i];
+        auto& out = packed[i];
+        glm::vec3 position = glm::clamp((vertex.Position - lower) * inverse + 0.5f, 0.0f, 65535.0f);
+        out.Position[0] = static_cast<uint16_t>(position.x);
+        out.Position[1] = static_cast<uint16_t>(position.y);
+        out.Position[2] = static_cast<uint16_t>(position.z);
+        out.Position[3] = 0;
+        // a zero normal stays zero instead of dividing by zero
+        glm::vec2 normal = glm::dot(vertex.Normal, vertex.Normal) > 0.0f ? octEncode(vertex.Normal) : glm::vec2(0.0f);
+        out.Normal[0] = static_cast<int16_t>(glm::packSnorm1x16(normal.x));
+        out.Normal[1] = static_cast<int16_t>(glm::packSnorm1x16(normal.y));
+        out.TexCoord[0] = glm::packHalf1x16(vertex.TexCoord.x);
+        out.TexCoord[1] = glm::packHalf1x16(vertex.TexCoord.y);
+    }
+    return quantization;
+}
+
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned> indices, std::vector<Texture> textures, Material materials, VertexFormat format, bool createBuffers)
+    : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)), materials(materials), format(format) {
+    setupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size(), createBuffers);
+}
+
+Mesh::Mesh(const Vertex* vertexData, size_t vertexCount, const unsigned* indexData, size_t indexCount, std::vector<Texture> textures, Material materials, VertexFormat format, bool createBuffers)
+    : textures(std::move(textures)), materials(materials), format(format) {
+    setupMesh(vertexData, vertexCount, indexData, indexCount, createBuffers);
 }
 
-void Mesh::setupMesh() {
+void Mesh::releaseGeometry() {
+    std::vector<Vertex>().swap(vertices);
+    std::vector<unsigned>().swap(indices);
+}
+
+void Mesh::setupMesh(const Vertex* vertexData, size_t vertexCount, const unsigned* indexData, size_t indexCount, bool createBuffers) {
+    this->indexCount = static_cast<unsigned>(indexCount);
+    if (lods.empty()) {
+        lods.push_back({0, this->indexCount, 0.0f});
+    }
+
+    glm::vec3 lower(0.0f), upper(0.0f);
+    for (size_t i{}; i < vertexCount; i ++) {
+        lower = i ? glm::min(lower, vertexData[i].Position) : vertexData[i].Position;
+        upper = i ? glm::max(upper, vertexData[i].Position) : vertexData[i].Position;
+    }
+    boundsCenter = (lower + upper) * 0.5f;
+    boundsExtent = (upper - lower) * 0.5f;
+    boundsRadius = glm::length(boundsExtent);
+
+    VAO = VBO = EBO = 0;
+    indexType = GL_UNSIGNED_INT;
+    if (!createBuffers) {
+        return;
+    }
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
@@ -63,10 +244,36 @@ void Mesh::setupMesh() {
     glBindVertexArray(VAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+    if (format == VertexFormat::Packed) {
+        std::vector<PackedVertex> packed;
+        quantization = packVertices(vertexData, vertexCount, packed);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(PackedVertex), packed.data(), GL_STATIC_DRAW);
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertexData, GL_STATIC_DRAW);
+    }
 
+    // 16-bit indices whenever every vertex is addressable by them
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned), indices.data(), GL_STATIC_DRAW);
+    if (vertexCount <= 65536) {
+        indexType = GL_UNSIGNED_SHORT;
+        std::vector<uint16_t> shortIndices(indexData, indexData + indexCount);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(uint16_t), shortIndices.data(), GL_STATIC_DRAW);
+    } else {
+        indexType = GL_UNSIGNED_INT;
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned), indexData, GL_STATIC_DRAW);
+    }
+
+    if (format == VertexFormat::Packed) {
+        // normalized integers come in as [0, 1] / [-1, 1], model.vs applies the quantization
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*) offsetof(PackedVertex, Position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*) offsetof(PackedVertex, Normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*) offsetof(PackedVertex, TexCoord));
+        glBindVertexArray(0);
+        return;
+    }
 
     // vertex positionn
     glEnableVertexAttribArray(0);
@@ -87,7 +294,7 @@ void Mesh::setupMesh() {
     glBindVertexArray(0);
 }
 
-void Mesh::Draw(Shader& shader) {
+void Mesh::bindMaterial(Shader& shader) {
     // bind appropriate textures    
     unsigned diffuseNr = 1;
     unsigned specularNr = 1;
@@ -114,7 +321,7 @@ void Mesh::Draw(Shader& shader) {
         // }
 
         shader.setInt1(name + number, i);
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        glBindTexture(GL_TEXTURE_2D, textures[i].id());
     }
 
     // material color
@@ -124,11 +331,105 @@ void Mesh::Draw(Shader& shader) {
 
     // Bind texture
     glActiveTexture(GL_TEXTURE0);
+}
+
+void Mesh::bindVertexFormat(Shader& shader) {
+    shader.setInt1("uPackedVertices", format == VertexFormat::Packed);
+    shader.setVec3("uPositionOffset", quantization.offset);
+    shader.setVec3("uPositionScale", quantization.scale);
+}
+
+void Mesh::releaseBuffers() {
+    if (VAO) {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        VAO = VBO = EBO = 0;
+    }
+}
+
+void Mesh::Draw(Shader& shader, unsigned lod) {
+    bindMaterial(shader);
+    bindVertexFormat(shader);
+    shader.setInt1("uInstanced", 0);
 
     // Draw mesh
     glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, static_cast<unsigned>(indices.size()), GL_UNSIGNED_INT, 0);
+    auto& level = lods[std::min<size_t>(lod, lods.size() - 1)];
+    size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned);
+    glDrawElements(GL_TRIANGLES, level.indexCount, indexType, (void*) (level.firstIndex * indexSize));
+    glBindVertexArray(0);
+    renderStats.addDraw(level.indexCount);
+}
+
+void Mesh::DrawRanges(Shader& shader, const GLsizei* counts, const uint32_t* firstIndices, GLsizei drawCount) {
+    if (drawCount == 0) {
+        return;
+    }
+    bindMaterial(shader);
+    bindVertexFormat(shader);
+    shader.setInt1("uInstanced", 0);
+
+    size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned);
+    std::vector<const void*> offsets(drawCount);
+    uint64_t indexCount = 0;
+    for (GLsizei i{}; i < drawCount; i ++) {
+        offsets[i] = (const void*) (firstIndices[i] * indexSize);
+        indexCount += counts[i];
+    }
+    glBindVertexArray(VAO);
+    glMultiDrawElements(GL_TRIANGLES, counts, indexType, offsets.data(), drawCount);
     glBindVertexArray(0);
+    renderStats.addDraw(indexCount);
+}
+
+void Mesh::DrawInstanced(Shader& shader, unsigned instanceBuffer, GLsizei instanceCount) {
+    bindMaterial(shader);
+    bindVertexFormat(shader);
+    shader.setInt1("uInstanced", 1);
+
+    // the VAO is shared by every instance set of the model, so the matrix attributes are
+    // pointed at this set's buffer per draw and switched off again for plain Draw calls
+    glBindVertexArray(VAO);
+    enableInstanceAttributes(instanceBuffer);
+    glDrawElementsInstanced(GL_TRIANGLES, lods[0].indexCount, indexType, 0, instanceCount);
+    renderStats.addDraw(lods[0].indexCount, instanceCount);
+    disableInstanceAttributes();
+    glBindVertexArray(0);
+}
+
+void enableInstanceAttributes(unsigned buffer) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    for (unsigned column{}; column < 4; column ++) {
+        glEnableVertexAttribArray(INSTANCE_MATRIX_LOCATION + column);
+        glVertexAttribPointer(INSTANCE_MATRIX_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+            (void*) (offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(INSTANCE_MATRIX_LOCATION + column, 1);
+    }
+    for (unsigned column{}; column < 3; column ++) {
+        glEnableVertexAttribArray(INSTANCE_NORMAL_LOCATION + column);
+        glVertexAttribPointer(INSTANCE_NORMAL_LOCATION + column, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+            (void*) (offsetof(InstanceData, normal) + column * sizeof(glm::vec3)));
+        glVertexAttribDivisor(INSTANCE_NORMAL_LOCATION + column, 1);
+    }
+}
+
+void disableInstanceAttributes() {
+    for (unsigned location = INSTANCE_MATRIX_LOCATION; location < INSTANCE_NORMAL_LOCATION + 3; location ++) {
+        glDisableVertexAttribArray(location);
+    }
+}
+
+void setModelMatrix(Shader& shader, const glm::mat4& model) {
+    glm::mat4 normal = glm::inverse(glm::transpose(model));
+    shader.setMat4("model", glm::value_ptr(model));
+    shader.setMat4("NormalMatrix", glm::value_ptr(normal));
+}
 
+void setNodeMatrix(Shader& shader, const glm::mat4& node) {
+    // once per mesh, so the inverse stays off the shader like the per-instance one
+    glm::mat3 normal = glm::transpose(glm::inverse(glm::mat3(node)));
+    shader.setMat4("uNodeMatrix", glm::value_ptr(node));
+    shader.setMat3("uNodeNormalMatrix", glm::value_ptr(normal));
 }
 #endif // MESH_H
\ No newline at end of file
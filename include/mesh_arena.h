@@ -0,0 +1,275 @@
+#ifndef MESH_ARENA_H
+#define MESH_ARENA_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "mesh.h"
+#include "scene_graph.h"
+#include "shader_s.h"
+
+// the meshes of one model or of a whole scene in a single VAO with one vertex and one index buffer;
+// each mesh is a range (first index, base vertex) holding all of its LODs, and ranges sharing
+// a material and a scene node are drawn with one glMultiDrawElementsBaseVertex
+class MeshArena {
+public:
+    explicit MeshArena(VertexFormat format = VertexFormat::Float): format(format) {}
+    ~MeshArena();
+    MeshArena(const MeshArena&) = delete;
+    MeshArena& operator=(const MeshArena&) = delete;
+
+    // append a mesh, it needs its CPU geometry (Residency::Keep or Model::requireGeometry())
+    // and must outlive the arena, its textures and material are used for drawing;
+    // node is the SceneGraph node whose world matrix the draws below place the mesh with
+    bool add(Mesh& mesh, uint32_t node = 0);
+    // the same with the geometry read from elsewhere (MeshData, a mapped mesh cache), copied
+    // before returning; indices must cover every LOD in mesh.lods
+    bool add(Mesh& mesh, const Vertex* vertexData, size_t vertexCount, const unsigned* indexData, uint32_t node = 0);
+    // upload everything added so far, afterwards the arena is drawable and add() is closed
+    void build();
+
+    // the caller's model uniform for every range, no node transforms
+    void Draw(Shader& shader);
+    // each range at model times the world matrix of its node, nodes already updated
+    void Draw(Shader& shader, const glm::mat4& model, const SceneGraph& nodes);
+    // only the listed ranges (indices in add() order), visible[i] at LOD lods[i], placed as above;
+    // the multi-draw lists are rebuilt on every call
+    void Draw(Shader& shader, const glm::mat4& model, const SceneGraph& nodes, const std::vector<uint32_t>& visible,
+        const std::vector<unsigned>& lods);
+    // per-instance InstanceData as in Mesh::DrawInstanced, one draw per range, each under its node
+    void DrawInstanced(Shader& shader, unsigned instanceBuffer, GLsizei instanceCount, const SceneGraph& nodes);
+
+    size_t rangeCount() const { return ranges.size(); }
+    size_t groupCount() const { return groups.size(); }
+private:
+    struct Range {
+        Mesh* mesh;
+        uint32_t node;
+        size_t firstIndex;  // of the mesh's index block, LOD ranges are relative to it
+        GLint baseVertex;
+        size_t group;       // set by build()
+    };
+    // ranges with identical textures and material colors under the same node
+    struct MaterialGroup {
+        Mesh* material;
+        uint32_t node;
+        std::vector<GLsizei> counts;
+        std::vector<const void*> offsets;
+        std::vector<GLint> baseVertices;
+    };
+
+    VertexFormat format;
+    VertexQuantization quantization;
+    std::vector<Vertex> vertices; // staging until build()
+    std::vector<unsigned> indices;
+    std::vector<Range> ranges;
+    std::vector<MaterialGroup> groups;    // every range at full detail
+    std::vector<MaterialGroup> selection; // the same groups, refilled by the selective Draw
+    unsigned VAO = 0, VBO = 0, EBO = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    size_t indexSize = sizeof(unsigned);
+
+    static bool sameMaterial(const Mesh& a, const Mesh& b);
+    void bindVertexFormat(Shader& shader);
+    // model == nullptr leaves the model uniform alone, empty groups are skipped
+    void drawGroups(Shader& shader, const glm::mat4* model, const SceneGraph* nodes, const std::vector<MaterialGroup>& drawn);
+};
+
+MeshArena::~MeshArena() {
+    if (VAO && glfwGetCurrentContext()) {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+    }
+}
+
+bool MeshArena::add(Mesh& mesh, uint32_t node) {
+    if (!mesh.hasGeometry()) {
+        std::cerr << "ERROR::MESH_ARENA: mesh added without CPU geometry\n";
+        return false;
+    }
+    return add(mesh, mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), node);
+}
+
+bool MeshArena::add(Mesh& mesh, const Vertex* vertexData, size_t vertexCount, const unsigned* indexData, uint32_t node) {
+    if (VAO) {
+        std::cerr << "ERROR::MESH_ARENA: mesh added after build\n";
+        return false;
+    }
+    // indices stay mesh-local, the base vertex offsets them at draw time
+    size_t indexCount{};
+    for (auto& level : mesh.lods) {
+        indexCount = std::max<size_t>(indexCount, level.firstIndex + level.indexCount);
+    }
+    ranges.push_back({&mesh, node, indices.size(), static_cast<GLint>(vertices.size()), 0});
+    vertices.insert(vertices.end(), vertexData, vertexData + vertexCount);
+    indices.insert(indices.end(), indexData, indexData + indexCount);
+    return true;
+}
+
+bool MeshArena::sameMaterial(const Mesh& a, const Mesh& b) {
+    if (a.textures.size() != b.textures.size()
+        || std::memcmp(&a.materials, &b.materials, sizeof(Material)) != 0) {
+        return false;
+    }
+    for (size_t i{}; i < a.textures.size(); i ++) {
+        if (a.textures[i].id() != b.textures[i].id() || a.textures[i].type != b.textures[i].type) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void MeshArena::build() {
+    if (VAO) {
+        return;
+    }
+    // 16-bit indices when every range addresses at most 65536 vertices
+    size_t largestRange{};
+    for (size_t i{}; i < ranges.size(); i ++) {
+        size_t end = i + 1 < ranges.size() ? ranges[i + 1].baseVertex : vertices.size();
+        largestRange = std::max(largestRange, end - ranges[i].baseVertex);
+    }
+    bool shortIndices = largestRange <= 65536;
+    indexType = shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    indexSize = shortIndices ? sizeof(uint16_t) : sizeof(unsigned);
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glBindVertexArray(VAO);
+
+    // packed arenas quantize against the bounds of all ranges, so one set of uniforms decodes them all
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    if (format == VertexFormat::Packed) {
+        std::vector<PackedVertex> packed;
+        quantization = packVertices(vertices.data(), vertices.size(), packed);
+        glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(PackedVertex), packed.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*) offsetof(PackedVertex, Position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*) offsetof(PackedVertex, Normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*) offsetof(PackedVertex, TexCoord));
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) 0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, Normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, TexCoord));
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    if (shortIndices) {
+        std::vector<uint16_t> shortData(indices.begin(), indices.end());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortData.size() * sizeof(uint16_t), shortData.data(), GL_STATIC_DRAW);
+    } else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned), indices.data(), GL_STATIC_DRAW);
+    }
+    glBindVertexArray(0);
+
+    // group ranges by material and node, keeping first-seen order; a node matrix is a uniform,
+    // so meshes under different nodes cannot share a draw
+    for (auto& range : ranges) {
+        auto group = std::find_if(groups.begin(), groups.end(), [&](const MaterialGroup& g) {
+            return g.node == range.node && sameMaterial(*g.material, *range.mesh);
+        });
+        if (group == groups.end()) {
+            groups.push_back({range.mesh, range.node, {}, {}, {}});
+            group = groups.end() - 1;
+        }
+        range.group = static_cast<size_t>(group - groups.begin());
+        auto& level = range.mesh->lods[0];
+        group->counts.push_back(static_cast<GLsizei>(level.indexCount));
+        group->offsets.push_back(reinterpret_cast<const void*>((range.firstIndex + level.firstIndex) * indexSize));
+        group->baseVertices.push_back(range.baseVertex);
+    }
+    for (auto& group : groups) {
+        selection.push_back({group.material, group.node, {}, {}, {}});
+    }
+
+    std::vector<Vertex>().swap(vertices);
+    std::vector<unsigned>().swap(indices);
+}
+
+void MeshArena::bindVertexFormat(Shader& shader) {
+    shader.setInt1("uPackedVertices", format == VertexFormat::Packed);
+    shader.setVec3("uPositionOffset", quantization.offset);
+    shader.setVec3("uPositionScale", quantization.scale);
+}
+
+void MeshArena::Draw(Shader& shader) {
+    drawGroups(shader, nullptr, nullptr, groups);
+}
+
+void MeshArena::Draw(Shader& shader, const glm::mat4& model, const SceneGraph& nodes) {
+    drawGroups(shader, &model, &nodes, groups);
+}
+
+void MeshArena::Draw(Shader& shader, const glm::mat4& model, const SceneGraph& nodes, const std::vector<uint32_t>& visible,
+    const std::vector<unsigned>& lods) {
+    for (auto& group : selection) {
+        group.counts.clear();
+        group.offsets.clear();
+        group.baseVertices.clear();
+    }
+    for (size_t i{}; i < visible.size(); i ++) {
+        auto& range = ranges[visible[i]];
+        auto& level = range.mesh->lods[std::min<size_t>(lods[i], range.mesh->lods.size() - 1)];
+        auto& group = selection[range.group];
+        group.counts.push_back(static_cast<GLsizei>(level.indexCount));
+        group.offsets.push_back(reinterpret_cast<const void*>((range.firstIndex + level.firstIndex) * indexSize));
+        group.baseVertices.push_back(range.baseVertex);
+    }
+    drawGroups(shader, &model, &nodes, selection);
+}
+
+void MeshArena::drawGroups(Shader& shader, const glm::mat4* model, const SceneGraph* nodes, const std::vector<MaterialGroup>& drawn) {
+    bindVertexFormat(shader);
+    shader.setInt1("uInstanced", 0);
+    glBindVertexArray(VAO);
+    for (auto& group : drawn) {
+        if (group.counts.empty()) {
+            continue;
+        }
+        if (model) {
+            setModelMatrix(shader, *model * nodes->world(group.node));
+        }
+        group.material->bindMaterial(shader);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, group.counts.data(), indexType, group.offsets.data(),
+            static_cast<GLsizei>(group.counts.size()), group.baseVertices.data());
+        uint64_t indexCount = 0;
+        for (auto count : group.counts) {
+            indexCount += count;
+        }
+        renderStats.addDraw(indexCount);
+    }
+    glBindVertexArray(0);
+}
+
+void MeshArena::DrawInstanced(Shader& shader, unsigned instanceBuffer, GLsizei instanceCount, const SceneGraph& nodes) {
+    bindVertexFormat(shader);
+    shader.setInt1("uInstanced", 1);
+    glBindVertexArray(VAO);
+    enableInstanceAttributes(instanceBuffer);
+    // there is no instanced multi-draw before GL 4.3, so ranges go one by one inside the one VAO
+    for (auto& group : groups) {
+        setNodeMatrix(shader, nodes.world(group.node));
+        group.material->bindMaterial(shader);
+        for (size_t i{}; i < group.counts.size(); i ++) {
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, group.counts[i], indexType, group.offsets[i], instanceCount, group.baseVertices[i]);
+            renderStats.addDraw(group.counts[i], instanceCount);
+        }
+    }
+    disableInstanceAttributes();
+    glBindVertexArray(0);
+}
+
+#endif // MESH_ARENA_H
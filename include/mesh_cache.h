@@ -0,0 +1,308 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "mapped_file.h"
+#include "mesh.h"
+#include "scene_graph.h"
+#include "trace.h"
+
+// binary mesh cache stored next to the source model, e.g. Creeper.obj.meshcache
+// layout: header | entry table | node table | node names | per mesh: vertices, indices, texture refs, LOD table
+// every section is 8-byte aligned, so vertices and indices are uploaded straight from the mapping
+// the file is native-endian, it is a local cache and never shipped
+
+const std::string MESH_CACHE_EXTENSION = ".meshcache";
+constexpr uint32_t MESH_CACHE_MAGIC = 0x434d474c; // "LGMC"
+constexpr uint32_t MESH_CACHE_VERSION = 6;
+
+struct MeshCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceHash;  // hash of the source file bytes
+    uint32_t importFlags;  // aiPostProcessSteps used on the cache-miss path
+    uint32_t meshCount;
+    uint32_t processFlags; // our own conversion passes (ModelProcessFlags)
+    uint32_t nodeCount;    // scene graph nodes, in pre-order
+};
+
+struct MeshCacheEntry {
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t textureOffset;
+    uint64_t lodOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;   // all LODs
+    uint32_t textureCount;
+    uint32_t lodCount;
+    uint32_t node;         // scene graph node of the mesh
+    Material material;
+};
+
+struct MeshCacheNode {
+    uint32_t parent;       // SCENE_NO_PARENT for roots
+    uint32_t nameLength;   // names follow the node table back to back, 8-byte aligned as a whole
+    float local[16];       // column-major like glm
+};
+
+static_assert(std::is_trivially_copyable_v<Vertex> && sizeof(Vertex) == 8 * sizeof(float), "Vertex must stay tightly packed");
+static_assert(std::is_trivially_copyable_v<Material>, "Material is stored verbatim");
+static_assert(std::is_trivially_copyable_v<MeshLod>, "MeshLod is stored verbatim");
+
+class MeshCacheReader {
+public:
+    // map the cache, fails if it is missing, corrupt or stale
+    bool open(const std::string& path, uint64_t sourceHash, uint32_t importFlags, uint32_t processFlags);
+
+    unsigned meshCount() const { return mHeader ? mHeader->meshCount : 0; }
+    const MeshCacheEntry& entry(unsigned i) const { return mEntries[i]; }
+    const Vertex* vertices(unsigned i) const { return reinterpret_cast<const Vertex*>(mFile.data() + mEntries[i].vertexOffset); }
+    const unsigned* indices(unsigned i) const { return reinterpret_cast<const unsigned*>(mFile.data() + mEntries[i].indexOffset); }
+    std::vector<TextureRef> textures(unsigned i) const;
+    std::vector<MeshLod> lods(unsigned i) const;
+    // append the stored hierarchy to an empty graph
+    void readNodes(SceneGraph& graph) const;
+private:
+    MappedFile mFile;
+    const MeshCacheHeader* mHeader = nullptr;
+    const MeshCacheEntry* mEntries = nullptr;
+    const MeshCacheNode* mNodes = nullptr;
+
+    bool readTextures(const MeshCacheEntry&, std::vector<TextureRef>*) const;
+    bool validIndices(const MeshCacheEntry&) const;
+};
+
+// write all meshes into a cache file, the file is replaced atomically
+// MeshType is Mesh (with its CPU copy) or MeshData, e.g. straight from Model::readData
+template <typename MeshType>
+bool writeMeshCache(const std::string& path, uint64_t sourceHash, uint32_t importFlags, uint32_t processFlags,
+    const std::vector<MeshType>& meshes, const std::vector<uint32_t>& meshNodes, const SceneGraph& graph);
+
+const Material& cachedMaterial(const Mesh& mesh) { return mesh.materials; }
+const Material& cachedMaterial(const MeshData& mesh) { return mesh.material; }
+
+uint64_t alignCacheOffset(uint64_t offset) {
+    return (offset + 7) & ~uint64_t(7);
+}
+
+bool MeshCacheReader::open(const std::string& path, uint64_t sourceHash, uint32_t importFlags, uint32_t processFlags) {
+    mHeader = nullptr;
+    mEntries = nullptr;
+    mNodes = nullptr;
+    if (!mFile.open(path) || mFile.size() < sizeof(MeshCacheHeader)) {
+        return false;
+    }
+
+    auto header = reinterpret_cast<const MeshCacheHeader*>(mFile.data());
+    if (header->magic != MESH_CACHE_MAGIC || header->version != MESH_CACHE_VERSION
+        || header->sourceHash != sourceHash || header->importFlags != importFlags || header->processFlags != processFlags) {
+        mFile.close();
+        return false;
+    }
+
+    uint64_t nodeOffset = alignCacheOffset(sizeof(MeshCacheHeader) + uint64_t(header->meshCount) * sizeof(MeshCacheEntry));
+    if (!cacheSectionFits(nodeOffset, header->nodeCount, sizeof(MeshCacheNode), mFile.size())) {
+        mFile.close();
+        return false;
+    }
+    // parents come first and names fit, so readNodes() rebuilds a valid graph
+    auto nodes = reinterpret_cast<const MeshCacheNode*>(mFile.data() + nodeOffset);
+    uint64_t namesEnd = nodeOffset + uint64_t(header->nodeCount) * sizeof(MeshCacheNode);
+    for (uint32_t n{}; n < header->nodeCount; n ++) {
+        namesEnd += nodes[n].nameLength;
+        if ((nodes[n].parent != SCENE_NO_PARENT && nodes[n].parent >= n) || namesEnd > mFile.size()) {
+            mFile.close();
+            return false;
+        }
+    }
+
+    // bounds check every section once, accessors trust the table afterwards
+    auto entries = reinterpret_cast<const MeshCacheEntry*>(mFile.data() + sizeof(MeshCacheHeader));
+    for (unsigned i{}; i < header->meshCount; i ++) {
+        auto& e = entries[i];
+        if (!cacheSectionFits(e.vertexOffset, e.vertexCount, sizeof(Vertex), mFile.size())
+            || !cacheSectionFits(e.indexOffset, e.indexCount, sizeof(unsigned), mFile.size())
+            || !cacheSectionFits(e.lodOffset, e.lodCount, sizeof(MeshLod), mFile.size())
+            || e.vertexOffset % alignof(Vertex) || e.indexOffset % alignof(unsigned)
+            || (e.node >= header->nodeCount && header->nodeCount)
+            || !readTextures(e, nullptr) || !validIndices(e)) {
+            mFile.close();
+            return false;
+        }
+    }
+
+    mHeader = header;
+    mEntries = entries;
+    mNodes = nodes;
+    return true;
+}
+
+std::vector<TextureRef> MeshCacheReader::textures(unsigned i) const {
+    std::vector<TextureRef> refs;
+    readTextures(mEntries[i], &refs);
+    return refs;
+}
+
+std::vector<MeshLod> MeshCacheReader::lods(unsigned i) const {
+    auto& e = mEntries[i];
+    std::vector<MeshLod> levels(e.lodCount);
+    std::memcpy(levels.data(), mFile.data() + e.lodOffset, levels.size() * sizeof(MeshLod));
+    return levels;
+}
+
+void MeshCacheReader::readNodes(SceneGraph& graph) const {
+    auto names = reinterpret_cast<const char*>(mNodes + mHeader->nodeCount);
+    for (uint32_t n{}; n < mHeader->nodeCount; n ++) {
+        glm::mat4 local;
+        std::memcpy(&local, mNodes[n].local, sizeof(local));
+        graph.addNode(mNodes[n].parent, local, std::string(names, mNodes[n].nameLength));
+        names += mNodes[n].nameLength;
+    }
+}
+
+// texture refs are stored as (uint32 typeLength, uint32 pathLength, chars), 4-byte aligned
+bool MeshCacheReader::readTextures(const MeshCacheEntry& e, std::vector<TextureRef>* refs) const {
+    uint64_t offset = e.textureOffset;
+    for (unsigned t{}; t < e.textureCount; t ++) {
+        uint32_t lengths[2];
+        if (!cacheSectionFits(offset, 1, sizeof(lengths), mFile.size())) {
+            return false;
+        }
+        std::memcpy(lengths, mFile.data() + offset, sizeof(lengths));
+        offset += sizeof(lengths);
+        if (!cacheSectionFits(offset, uint64_t(lengths[0]) + lengths[1], 1, mFile.size())) {
+            return false;
+        }
+        if (refs) {
+            auto chars = reinterpret_cast<const char*>(mFile.data() + offset);
+            refs->push_back({std::string(chars, lengths[0]), std::string(chars + lengths[0], lengths[1])});
+        }
+        offset = (offset + lengths[0] + lengths[1] + 3) & ~uint64_t(3);
+    }
+    return true;
+}
+
+// every index names a stored vertex and every LOD range lies inside the index section
+bool MeshCacheReader::validIndices(const MeshCacheEntry& e) const {
+    auto indices = reinterpret_cast<const unsigned*>(mFile.data() + e.indexOffset);
+    unsigned maxIndex{};
+    for (uint32_t i{}; i < e.indexCount; i ++) {
+        maxIndex = std::max(maxIndex, indices[i]);
+    }
+    if (e.indexCount && maxIndex >= e.vertexCount) {
+        return false;
+    }
+    for (uint32_t l{}; l < e.lodCount; l ++) {
+        MeshLod lod;
+        std::memcpy(&lod, mFile.data() + e.lodOffset + l * sizeof(MeshLod), sizeof(lod));
+        if (lod.firstIndex > e.indexCount || lod.indexCount > e.indexCount - lod.firstIndex) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename MeshType>
+bool writeMeshCache(const std::string& path, uint64_t sourceHash, uint32_t importFlags, uint32_t processFlags,
+    const std::vector<MeshType>& meshes, const std::vector<uint32_t>& meshNodes, const SceneGraph& graph) {
+    TRACE_SCOPE("writeMeshCache");
+    MeshCacheHeader header{MESH_CACHE_MAGIC, MESH_CACHE_VERSION, sourceHash, importFlags, static_cast<uint32_t>(meshes.size()),
+        processFlags, static_cast<uint32_t>(graph.size())};
+
+    std::vector<MeshCacheNode> nodes(graph.size());
+    uint64_t nameBytes{};
+    for (uint32_t n{}; n < graph.size(); n ++) {
+        nodes[n].parent = graph.parent(n);
+        nodes[n].nameLength = static_cast<uint32_t>(graph.name(n).size());
+        std::memcpy(nodes[n].local, &graph.local(n), sizeof(nodes[n].local));
+        nameBytes += nodes[n].nameLength;
+    }
+
+    // lay out sections first so the entry table can be written up front
+    std::vector<MeshCacheEntry> entries(meshes.size());
+    std::memset(entries.data(), 0, entries.size() * sizeof(MeshCacheEntry));
+    uint64_t nodeOffset = alignCacheOffset(sizeof(MeshCacheHeader) + entries.size() * sizeof(MeshCacheEntry));
+    uint64_t offset = alignCacheOffset(nodeOffset + nodes.size() * sizeof(MeshCacheNode) + nameBytes);
+    for (size_t i{}; i < meshes.size(); i ++) {
+        auto& mesh = meshes[i];
+        auto& e = entries[i];
+        e.node = i < meshNodes.size() ? meshNodes[i] : 0;
+        e.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+        e.indexCount = static_cast<uint32_t>(mesh.indices.size());
+        e.textureCount = static_cast<uint32_t>(mesh.textures.size());
+        e.lodCount = static_cast<uint32_t>(mesh.lods.size());
+        e.material = cachedMaterial(mesh);
+
+        e.vertexOffset = offset;
+        offset = alignCacheOffset(offset + mesh.vertices.size() * sizeof(Vertex));
+        e.indexOffset = offset;
+        offset = alignCacheOffset(offset + mesh.indices.size() * sizeof(unsigned));
+        e.textureOffset = offset;
+        for (auto& texture : mesh.textures) {
+            offset = (offset + 2 * sizeof(uint32_t) + texture.type.size() + texture.path.size() + 3) & ~uint64_t(3);
+        }
+        offset = alignCacheOffset(offset);
+        e.lodOffset = offset;
+        offset = alignCacheOffset(offset + mesh.lods.size() * sizeof(MeshLod));
+    }
+
+    // one temporary per thread: loader threads may write the same source's cache at once
+    std::string tmpPath = path + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+
+    auto padTo = [&file](uint64_t target) {
+        static const char zeros[8]{};
+        uint64_t pos = static_cast<uint64_t>(file.tellp());
+        file.write(zeros, static_cast<std::streamsize>(target - pos));
+    };
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(MeshCacheEntry)));
+    padTo(nodeOffset);
+    file.write(reinterpret_cast<const char*>(nodes.data()), static_cast<std::streamsize>(nodes.size() * sizeof(MeshCacheNode)));
+    for (uint32_t n{}; n < graph.size(); n ++) {
+        file.write(graph.name(n).data(), static_cast<std::streamsize>(graph.name(n).size()));
+    }
+    for (size_t i{}; i < meshes.size(); i ++) {
+        auto& mesh = meshes[i];
+        auto& e = entries[i];
+        padTo(e.vertexOffset);
+        file.write(reinterpret_cast<const char*>(mesh.vertices.data()), static_cast<std::streamsize>(mesh.vertices.size() * sizeof(Vertex)));
+        padTo(e.indexOffset);
+        file.write(reinterpret_cast<const char*>(mesh.indices.data()), static_cast<std::streamsize>(mesh.indices.size() * sizeof(unsigned)));
+        padTo(e.textureOffset);
+        for (auto& texture : mesh.textures) {
+            uint32_t lengths[2] = {static_cast<uint32_t>(texture.type.size()), static_cast<uint32_t>(texture.path.size())};
+            file.write(reinterpret_cast<const char*>(lengths), sizeof(lengths));
+            file.write(texture.type.data(), lengths[0]);
+            file.write(texture.path.data(), lengths[1]);
+            padTo((static_cast<uint64_t>(file.tellp()) + 3) & ~uint64_t(3));
+        }
+        padTo(e.lodOffset);
+        file.write(reinterpret_cast<const char*>(mesh.lods.data()), static_cast<std::streamsize>(mesh.lods.size() * sizeof(MeshLod)));
+    }
+    padTo(offset);
+    file.close();
+    if (!file) {
+        std::filesystem::remove(tmpPath);
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    return !ec;
+}
+
+#endif // MESH_CACHE_H
@@ -0,0 +1,765 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <algorithm>
+#include <bit>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "hash.h"
+#include "mesh.h"
+#include "thread_pool.h"
+
+// CPU-side passes over MeshData, run in the conversion stage before upload
+
+// merge vertices whose quantized position/normal/texcoord bits are equal, indices are remapped
+// the first occurrence of each vertex is kept, so the result is deterministic
+void weldVertices(MeshData& data);
+
+// reorder triangles for the post-transform vertex cache (Forsyth's linear-speed greedy scoring)
+void optimizeVertexCache(std::vector<unsigned>& indices, size_t vertexCount);
+
+// split the cache-ordered triangles into clusters and draw outward-facing clusters first
+// threshold allows clusters to cost that much more ACMR than the input in exchange for finer sorting
+void optimizeOverdraw(std::vector<unsigned>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f);
+
+// vertex count addressable by 16-bit indices
+constexpr size_t SHORT_INDEX_VERTEX_LIMIT = 65536;
+
+// cut a mesh into runs of consecutive triangles that each reference at most maxVertices vertices,
+// duplicating vertices on run boundaries; returns the mesh whole when the split would not save memory
+std::vector<MeshData> splitForShortIndices(MeshData&& data, size_t maxVertices = SHORT_INDEX_VERTEX_LIMIT);
+
+// collapse edges by quadric error until targetIndexCount or maxError (object-space distance) is reached;
+// vertices on open borders (material boundaries, holes) and on UV/normal seams never move and others
+// only collapse onto an existing neighbour, so the result indexes the unchanged vertex buffer
+std::vector<unsigned> simplifyMesh(const std::vector<unsigned>& indices, const std::vector<Vertex>& vertices,
+    size_t targetIndexCount, float maxError, float* resultError = nullptr);
+
+// append up to lodCount - 1 levels of about half the triangles each behind the full index list,
+// data.lods describes every level; stops early once a level no longer shrinks
+void generateLods(MeshData& data, unsigned lodCount);
+
+// FIFO cache simulation: ACMR = transformed vertices per triangle, ATVR = per referenced vertex
+struct VertexCacheStats {
+    size_t transformed;
+    float acmr;
+    float atvr;
+};
+VertexCacheStats analyzeVertexCache(const unsigned* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize = 16);
+
+// scoring cache of the Forsyth pass, larger than any real FIFO so the greedy choice looks ahead
+constexpr unsigned VERTEX_CACHE_SCORE_SIZE = 32;
+// FIFO size used to find cluster boundaries in the overdraw pass
+constexpr unsigned VERTEX_CACHE_FIFO_SIZE = 16;
+
+// vertex key: floats with the low mantissa bits rounded away, normals as 16-bit snorm
+struct WeldKey {
+    uint32_t position[3];
+    uint32_t normal[2];
+    uint32_t texcoord[2];
+
+    bool operator==(const WeldKey& other) const { return std::memcmp(this, &other, sizeof(WeldKey)) == 0; }
+};
+
+// round away the 4 lowest mantissa bits (~1e-6 relative), and fold -0 into 0
+uint32_t weldQuantizeFloat(float value) {
+    if (value == 0.0f) {
+        return 0;
+    }
+    return (std::bit_cast<uint32_t>(value) + 8u) & ~15u;
+}
+
+uint32_t weldQuantizeSnorm(float value) {
+    return static_cast<uint16_t>(static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f)));
+}
+
+WeldKey makeWeldKey(const Vertex& vertex) {
+    WeldKey key;
+    key.position[0] = weldQuantizeFloat(vertex.Position.x);
+    key.position[1] = weldQuantizeFloat(vertex.Position.y);
+    key.position[2] = weldQuantizeFloat(vertex.Position.z);
+    key.normal[0] = weldQuantizeSnorm(vertex.Normal.x) | (weldQuantizeSnorm(vertex.Normal.y) << 16);
+    key.normal[1] = weldQuantizeSnorm(vertex.Normal.z);
+    key.texcoord[0] = weldQuantizeFloat(vertex.TexCoord.x);
+    key.texcoord[1] = weldQuantizeFloat(vertex.TexCoord.y);
+    return key;
+}
+
+// 64-bit mix of the key words (murmur3 finalizer per word)
+uint64_t hashWeldKey(const WeldKey& key) {
+    uint32_t words[7];
+    std::memcpy(words, &key, sizeof(words));
+    uint64_t hash = 0x9e3779b97f4a7c15ull;
+    for (auto word : words) {
+        hash ^= word;
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+    }
+    return hash;
+}
+
+void weldVertices(MeshData& data) {
+    auto& vertices = data.vertices;
+    size_t count = vertices.size();
+    if (count < 2) {
+        return;
+    }
+
+    // hash every vertex in parallel blocks
+    constexpr size_t blockSize = 1 << 14;
+    size_t blockCount = (count + blockSize - 1) / blockSize;
+    std::vector<WeldKey> keys(count);
+    std::vector<uint64_t> hashes(count);
+    auto& pool = ThreadPool::global();
+    pool.parallelFor(blockCount, [&](size_t block) {
+        for (size_t i = block * blockSize; i < std::min(count, (block + 1) * blockSize); i ++) {
+            keys[i] = makeWeldKey(vertices[i]);
+            hashes[i] = hashWeldKey(keys[i]);
+        }
+    });
+
+    // equal keys share a hash, so partitions by the top hash bits weld independently
+    size_t partitionCount = std::bit_ceil(std::min<size_t>(blockCount, (pool.size() + 1) * 4));
+    unsigned partitionShift = 64 - std::countr_zero(partitionCount);
+    std::vector<std::vector<uint32_t>> partitions(partitionCount);
+    for (size_t i{}; i < count; i ++) {
+        partitions[partitionCount > 1 ? hashes[i] >> partitionShift : 0].push_back(static_cast<uint32_t>(i));
+    }
+
+    // per partition open-addressing table (linear probing) from key to its first vertex
+    std::vector<uint32_t> representative(count);
+    pool.parallelFor(partitionCount, [&](size_t p) {
+        auto& ids = partitions[p];
+        size_t capacity = std::bit_ceil(std::max<size_t>(ids.size() * 2, 16));
+        std::vector<uint32_t> table(capacity, UINT32_MAX);
+        for (auto id : ids) {
+            size_t slot = hashes[id] & (capacity - 1);
+            while (true) {
+                uint32_t other = table[slot];
+                if (other == UINT32_MAX) {
+                    table[slot] = id;
+                    representative[id] = id;
+                    break;
+                }
+                if (hashes[other] == hashes[id] && keys[other] == keys[id]) {
+                    representative[id] = other;
+                    break;
+                }
+                slot = (slot + 1) & (capacity - 1);
+            }
+        }
+    });
+
+    // ids are visited in ascending order, so a representative always precedes its duplicates
+    std::vector<uint32_t> remap(count);
+    std::vector<Vertex> welded;
+    welded.reserve(count);
+    for (size_t i{}; i < count; i ++) {
+        if (representative[i] == i) {
+            remap[i] = static_cast<uint32_t>(welded.size());
+            welded.push_back(vertices[i]);
+        } else {
+            remap[i] = remap[representative[i]];
+        }
+    }
+    if (welded.size() == count) {
+        return;
+    }
+
+    auto& indices = data.indices;
+    size_t indexBlocks = (indices.size() + blockSize - 1) / blockSize;
+    pool.parallelFor(indexBlocks, [&](size_t block) {
+        for (size_t i = block * blockSize; i < std::min(indices.size(), (block + 1) * blockSize); i ++) {
+            indices[i] = remap[indices[i]];
+        }
+    });
+    welded.shrink_to_fit();
+    vertices = std::move(welded);
+}
+
+VertexCacheStats analyzeVertexCache(const unsigned* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize) {
+    // timestamp FIFO: a vertex is resident while fewer than cacheSize misses happened since it entered
+    std::vector<size_t> entered(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    size_t transformed{}, unique{};
+    for (size_t i{}; i < indexCount; i ++) {
+        unsigned v = indices[i];
+        if (!referenced[v]) {
+            referenced[v] = true;
+            unique ++;
+        }
+        if (entered[v] == 0 || transformed - entered[v] + 1 > cacheSize) {
+            transformed ++;
+            entered[v] = transformed;
+        }
+    }
+    size_t triangles = indexCount / 3;
+    return {transformed, triangles ? float(transformed) / float(triangles) : 0.0f, unique ? float(transformed) / float(unique) : 0.0f};
+}
+
+void optimizeVertexCache(std::vector<unsigned>& indices, size_t vertexCount) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2) {
+        return;
+    }
+    constexpr unsigned cacheSize = VERTEX_CACHE_SCORE_SIZE;
+    constexpr unsigned maxValence = 32;
+
+    // score tables from Forsyth's paper: the last triangle's vertices get a flat 0.75,
+    // the rest decay with cache position; vertices with few remaining triangles get boosted
+    float cacheScore[cacheSize + 3];
+    for (unsigned i{}; i < cacheSize + 3; i ++) {
+        if (i < 3) {
+            cacheScore[i] = 0.75f;
+        } else if (i < cacheSize) {
+            cacheScore[i] = std::pow(1.0f - float(i - 3) / float(cacheSize - 3), 1.5f);
+        } else {
+            cacheScore[i] = 0.0f;
+        }
+    }
+    float valenceScore[maxValence + 1];
+    valenceScore[0] = 0.0f;
+    for (unsigned i = 1; i <= maxValence; i ++) {
+        valenceScore[i] = 2.0f / std::sqrt(float(i));
+    }
+    auto vertexScore = [&](int cachePosition, unsigned remaining) {
+        if (remaining == 0) {
+            return -1.0f;
+        }
+        float score = cachePosition < 0 ? 0.0f : cacheScore[cachePosition];
+        return score + valenceScore[std::min(remaining, maxValence)];
+    };
+
+    // vertex -> triangle adjacency as offset table
+    std::vector<unsigned> remaining(vertexCount, 0);
+    for (auto index : indices) {
+        remaining[index] ++;
+    }
+    std::vector<size_t> adjacencyOffset(vertexCount + 1, 0);
+    for (size_t v{}; v < vertexCount; v ++) {
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+    }
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        std::vector<size_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (size_t t{}; t < triangleCount; t ++) {
+            for (int k{}; k < 3; k ++) {
+                adjacency[fill[indices[t * 3 + k]] ++] = static_cast<uint32_t>(t);
+            }
+        }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (size_t v{}; v < vertexCount; v ++) {
+        score[v] = vertexScore(-1, remaining[v]);
+    }
+    std::vector<float> triangleScore(triangleCount);
+    for (size_t t{}; t < triangleCount; t ++) {
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+    }
+    std::vector<bool> emitted(triangleCount, false);
+
+    // at a dead end no cached vertex has triangles left, so every remaining triangle scores by valence
+    // alone; a vertex only loses triangles while cached, so a lazy max-heap of those scores stays
+    // current if a vertex's triangles get fresh entries when it falls out of the cache,
+    // entries that no longer match the triangle's score are skipped when popped
+    auto restartScore = [&](size_t t) {
+        return vertexScore(-1, remaining[indices[t * 3]]) + vertexScore(-1, remaining[indices[t * 3 + 1]])
+            + vertexScore(-1, remaining[indices[t * 3 + 2]]);
+    };
+    std::vector<std::pair<float, uint32_t>> restart(triangleCount);
+    for (size_t t{}; t < triangleCount; t ++) {
+        restart[t] = {restartScore(t), static_cast<uint32_t>(t)};
+    }
+    std::make_heap(restart.begin(), restart.end());
+
+    std::vector<unsigned> output;
+    output.reserve(indices.size());
+    unsigned cache[cacheSize + 3];
+    unsigned cacheCount{};
+    size_t best = SIZE_MAX;
+
+    for (size_t emittedCount{}; emittedCount < triangleCount; emittedCount ++) {
+        // the first triangle, or nothing in the cache has triangles left: take the best remaining one
+        while (best == SIZE_MAX) {
+            std::pop_heap(restart.begin(), restart.end());
+            auto [restartValue, t] = restart.back();
+            restart.pop_back();
+            if (!emitted[t] && restartValue == restartScore(t)) {
+                best = t;
+            }
+        }
+        emitted[best] = true;
+        unsigned triangle[3] = {indices[best * 3], indices[best * 3 + 1], indices[best * 3 + 2]};
+        output.insert(output.end(), triangle, triangle + 3);
+
+        // drop the triangle from its vertices' adjacency
+        for (auto v : triangle) {
+            auto begin = adjacency.begin() + adjacencyOffset[v];
+            auto end = begin + remaining[v];
+            *std::find(begin, end, static_cast<uint32_t>(best)) = *(end - 1);
+            remaining[v] --;
+        }
+
+        // move the triangle's vertices to the front of the LRU cache
+        unsigned newCache[cacheSize + 3];
+        unsigned newCount{};
+        for (auto v : triangle) {
+            if (std::find(newCache, newCache + newCount, v) == newCache + newCount) {
+                newCache[newCount ++] = v;
+            }
+        }
+        // cache entries are unique already, only the triangle's own vertices can repeat
+        for (unsigned i{}; i < cacheCount; i ++) {
+            unsigned v = cache[i];
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                newCache[newCount ++] = v;
+            }
+        }
+
+        // rescore cached vertices, the ones pushed past the end fall out
+        for (unsigned i{}; i < newCount; i ++) {
+            unsigned v = newCache[i];
+            cachePosition[v] = i < cacheSize ? int(i) : -1;
+            float updated = vertexScore(cachePosition[v], remaining[v]);
+            float delta = updated - score[v];
+            score[v] = updated;
+            for (size_t a{}; a < remaining[v]; a ++) {
+                uint32_t t = adjacency[adjacencyOffset[v] + a];
+                triangleScore[t] += delta;
+                if (i >= cacheSize) {
+                    restart.push_back({restartScore(t), t});
+                    std::push_heap(restart.begin(), restart.end());
+                }
+            }
+        }
+        cacheCount = std::min(newCount, cacheSize);
+        std::copy(newCache, newCache + cacheCount, cache);
+
+        // the next triangle is the best one touching the cache
+        best = SIZE_MAX;
+        float bestScore = -1.0f;
+        for (unsigned i{}; i < cacheCount; i ++) {
+            unsigned v = cache[i];
+            for (size_t a{}; a < remaining[v]; a ++) {
+                uint32_t t = adjacency[adjacencyOffset[v] + a];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+    }
+    indices = std::move(output);
+}
+
+void optimizeOverdraw(std::vector<unsigned>& indices, const std::vector<Vertex>& vertices, float threshold) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2) {
+        return;
+    }
+
+    // misses per triangle under a FIFO cache, recorded on the cache-ordered input
+    std::vector<size_t> entered(vertices.size(), 0);
+    std::vector<uint8_t> misses(triangleCount);
+    size_t transformed{};
+    for (size_t t{}; t < triangleCount; t ++) {
+        uint8_t count{};
+        for (int k{}; k < 3; k ++) {
+            unsigned v = indices[t * 3 + k];
+            if (entered[v] == 0 || transformed - entered[v] + 1 > VERTEX_CACHE_FIFO_SIZE) {
+                transformed ++;
+                entered[v] = transformed;
+                count ++;
+            }
+        }
+        misses[t] = count;
+    }
+
+    // hard boundaries where the cache restarted (all three vertices missed), then soft splits
+    // at costly triangles whenever the running cluster stays within threshold of the hard cluster's ACMR
+    std::vector<size_t> clusters;
+    for (size_t start{}; start < triangleCount;) {
+        size_t end = start + 1;
+        size_t hardMisses = misses[start];
+        while (end < triangleCount && misses[end] != 3) {
+            hardMisses += misses[end ++];
+        }
+        float limit = float(hardMisses) / float(end - start) * threshold;
+        clusters.push_back(start);
+        size_t clusterMisses{};
+        for (size_t t = start; t < end; t ++) {
+            size_t length = t - clusters.back();
+            if (length > 0 && misses[t] >= 2 && float(clusterMisses) / float(length) <= limit) {
+                clusters.push_back(t);
+                clusterMisses = 0;
+            }
+            clusterMisses += misses[t];
+        }
+        start = end;
+    }
+    clusters.push_back(triangleCount);
+    size_t clusterCount = clusters.size() - 1;
+    if (clusterCount < 2) {
+        return;
+    }
+
+    // area-weighted centroid and normal per cluster, and of the whole mesh
+    std::vector<glm::vec3> centroid(clusterCount), normal(clusterCount);
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea{};
+    for (size_t c{}; c < clusterCount; c ++) {
+        glm::vec3 center(0.0f), direction(0.0f);
+        float area{};
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t ++) {
+            const glm::vec3& a = vertices[indices[t * 3]].Position;
+            const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3& d = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 cross = glm::cross(b - a, d - a);
+            float weight = glm::length(cross) * 0.5f;
+            center += (a + b + d) * (weight / 3.0f);
+            direction += cross;
+            area += weight;
+        }
+        meshCentroid += center;
+        meshArea += area;
+        centroid[c] = area > 0.0f ? center / area : center;
+        float length = glm::length(direction);
+        normal[c] = length > 0.0f ? direction / length : direction;
+    }
+    if (meshArea > 0.0f) {
+        meshCentroid /= meshArea;
+    }
+
+    // clusters facing away from the centre tend to occlude the rest, draw them first
+    std::vector<float> sortKey(clusterCount);
+    std::vector<size_t> order(clusterCount);
+    for (size_t c{}; c < clusterCount; c ++) {
+        sortKey[c] = glm::dot(centroid[c] - meshCentroid, normal[c]);
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+    std::vector<unsigned> output;
+    output.reserve(indices.size());
+    for (auto c : order) {
+        output.insert(output.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+    }
+    indices = std::move(output);
+}
+
+std::vector<MeshData> splitForShortIndices(MeshData&& data, size_t maxVertices) {
+    std::vector<MeshData> parts;
+    if (data.vertices.size() <= maxVertices || maxVertices < 3) {
+        parts.push_back(std::move(data));
+        return parts;
+    }
+
+    // owner[v] is the part that last copied vertex v, local[v] its index there
+    std::vector<size_t> owner(data.vertices.size(), SIZE_MAX);
+    std::vector<unsigned> local(data.vertices.size());
+    size_t splitVertices{};
+    for (size_t t{}; t + 2 < data.indices.size(); t += 3) {
+        const unsigned* triangle = &data.indices[t];
+        size_t missing{};
+        for (int k{}; k < 3; k ++) {
+            missing += owner[triangle[k]] != parts.size() - 1 || parts.empty();
+        }
+        if (parts.empty() || parts.back().vertices.size() + missing > maxVertices) {
+            parts.push_back({{}, {}, data.textures, data.material, {}, data.node});
+        }
+        auto& part = parts.back();
+        for (int k{}; k < 3; k ++) {
+            unsigned v = triangle[k];
+            if (owner[v] != parts.size() - 1) {
+                owner[v] = parts.size() - 1;
+                local[v] = static_cast<unsigned>(part.vertices.size());
+                part.vertices.push_back(data.vertices[v]);
+            }
+            part.indices.push_back(local[v]);
+        }
+    }
+    for (auto& part : parts) {
+        splitVertices += part.vertices.size();
+    }
+
+    // indices halve, duplicated boundary vertices are the price
+    size_t wholeBytes = data.vertices.size() * sizeof(Vertex) + data.indices.size() * sizeof(uint32_t);
+    size_t splitBytes = splitVertices * sizeof(Vertex) + data.indices.size() * sizeof(uint16_t);
+    if (splitBytes >= wholeBytes) {
+        parts.clear();
+        parts.push_back(std::move(data));
+    }
+    return parts;
+}
+
+// symmetric 4x4 quadric of summed squared plane distances, weight counts the planes
+struct Quadric {
+    double xx, xy, xz, xw, yy, yz, yw, zz, zw, ww;
+    double weight;
+
+    void addPlane(const glm::dvec3& n, double d) {
+        xx += n.x * n.x; xy += n.x * n.y; xz += n.x * n.z; xw += n.x * d;
+        yy += n.y * n.y; yz += n.y * n.z; yw += n.y * d;
+        zz += n.z * n.z; zw += n.z * d;
+        ww += d * d;
+        weight += 1.0;
+    }
+    void add(const Quadric& q) {
+        xx += q.xx; xy += q.xy; xz += q.xz; xw += q.xw; yy += q.yy;
+        yz += q.yz; yw += q.yw; zz += q.zz; zw += q.zw; ww += q.ww;
+        weight += q.weight;
+    }
+    // mean squared distance of p to the planes
+    double error(const glm::vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double e = x * x * xx + 2 * x * y * xy + 2 * x * z * xz + 2 * x * xw + y * y * yy
+            + 2 * y * z * yz + 2 * y * yw + z * z * zz + 2 * z * zw + ww;
+        return e > 0.0 && weight > 0.0 ? e / weight : 0.0;
+    }
+};
+
+std::vector<unsigned> simplifyMesh(const std::vector<unsigned>& input, const std::vector<Vertex>& vertices,
+    size_t targetIndexCount, float maxError, float* resultError) {
+    std::vector<unsigned> indices(input.begin(), input.end() - input.size() % 3);
+    size_t vertexCount = vertices.size();
+    double maxCost = double(maxError) * maxError;
+    double worst{};
+
+    // vertices sharing a position with another vertex sit on a seam
+    std::vector<uint8_t> locked(vertexCount, 0);
+    {
+        std::vector<uint64_t> keys(vertexCount);
+        for (size_t v{}; v < vertexCount; v ++) {
+            keys[v] = hashBytes(&vertices[v].Position, sizeof(glm::vec3));
+        }
+        std::vector<uint32_t> order(vertexCount);
+        for (size_t v{}; v < vertexCount; v ++) {
+            order[v] = static_cast<uint32_t>(v);
+        }
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+        for (size_t i = 1; i < vertexCount; i ++) {
+            uint32_t a = order[i - 1], b = order[i];
+            if (keys[a] == keys[b] && vertices[a].Position == vertices[b].Position) {
+                locked[a] = locked[b] = 1;
+            }
+        }
+    }
+    // edges used by a single triangle are open borders
+    {
+        std::vector<uint64_t> edges;
+        edges.reserve(indices.size());
+        for (size_t t{}; t < indices.size(); t += 3) {
+            for (int k{}; k < 3; k ++) {
+                uint64_t a = indices[t + k], b = indices[t + (k + 1) % 3];
+                edges.push_back(std::min(a, b) << 32 | std::max(a, b));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        for (size_t i{}; i < edges.size();) {
+            size_t j = i;
+            while (j < edges.size() && edges[j] == edges[i]) {
+                j ++;
+            }
+            if (j - i == 1) {
+                locked[edges[i] >> 32] = locked[edges[i] & 0xffffffffu] = 1;
+            }
+            i = j;
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertexCount, Quadric{});
+    for (size_t t{}; t < indices.size(); t += 3) {
+        glm::dvec3 a = vertices[indices[t]].Position, b = vertices[indices[t + 1]].Position, c = vertices[indices[t + 2]].Position;
+        glm::dvec3 n = glm::cross(b - a, c - a);
+        double length = glm::length(n);
+        if (length == 0.0) {
+            continue;
+        }
+        n /= length;
+        for (int k{}; k < 3; k ++) {
+            quadrics[indices[t + k]].addPlane(n, -glm::dot(n, a));
+        }
+    }
+
+    struct Collapse {
+        unsigned from, to;
+        double cost;
+    };
+    std::vector<unsigned> remap(vertexCount);
+    std::vector<uint8_t> touched(vertexCount);
+    std::vector<size_t> adjacencyOffset(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<Collapse> collapses;
+
+    // passes of independent collapses, cheapest first, until the target or no legal collapse is left
+    while (indices.size() > targetIndexCount) {
+        // vertex -> triangle adjacency of the current index list
+        std::fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0);
+        for (auto index : indices) {
+            adjacencyOffset[index + 1] ++;
+        }
+        for (size_t v{}; v < vertexCount; v ++) {
+            adjacencyOffset[v + 1] += adjacencyOffset[v];
+        }
+        adjacency.resize(indices.size());
+        {
+            std::vector<size_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+            for (size_t i{}; i < indices.size(); i ++) {
+                adjacency[fill[indices[i]] ++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+
+        // cheapest outgoing edge per movable vertex
+        collapses.clear();
+        for (size_t v{}; v < vertexCount; v ++) {
+            if (locked[v] || adjacencyOffset[v] == adjacencyOffset[v + 1]) {
+                continue;
+            }
+            Collapse best{static_cast<unsigned>(v), 0, DBL_MAX};
+            for (size_t a = adjacencyOffset[v]; a < adjacencyOffset[v + 1]; a ++) {
+                const unsigned* tri = &indices[adjacency[a] * 3];
+                for (int k{}; k < 3; k ++) {
+                    if (tri[k] == v) {
+                        continue;
+                    }
+                    Quadric q = quadrics[v];
+                    q.add(quadrics[tri[k]]);
+                    double cost = q.error(vertices[tri[k]].Position);
+                    if (cost < best.cost || (cost == best.cost && tri[k] < best.to)) {
+                        best = {static_cast<unsigned>(v), tri[k], cost};
+                    }
+                }
+            }
+            if (best.cost <= maxCost) {
+                collapses.push_back(best);
+            }
+        }
+        if (collapses.empty()) {
+            break;
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+            return a.cost < b.cost || (a.cost == b.cost && a.from < b.from);
+        });
+
+        for (size_t v{}; v < vertexCount; v ++) {
+            remap[v] = static_cast<unsigned>(v);
+        }
+        std::fill(touched.begin(), touched.end(), 0);
+        // an interior collapse removes about two triangles
+        size_t budget = (indices.size() - targetIndexCount) / 6 + 1;
+        size_t applied{};
+        std::vector<unsigned> ringFrom, ringTo;
+        for (auto& c : collapses) {
+            if (applied >= budget) {
+                break;
+            }
+            if (touched[c.from] || touched[c.to]) {
+                continue;
+            }
+            auto trianglesOf = [&](unsigned v) {
+                return std::make_pair(adjacency.begin() + adjacencyOffset[v], adjacency.begin() + adjacencyOffset[v + 1]);
+            };
+
+            // link condition: a manifold edge has exactly two common neighbours
+            ringFrom.clear();
+            ringTo.clear();
+            auto [fromBegin, fromEnd] = trianglesOf(c.from);
+            auto [toBegin, toEnd] = trianglesOf(c.to);
+            for (auto it = fromBegin; it != fromEnd; ++ it) {
+                ringFrom.insert(ringFrom.end(), &indices[*it * 3], &indices[*it * 3] + 3);
+            }
+            for (auto it = toBegin; it != toEnd; ++ it) {
+                ringTo.insert(ringTo.end(), &indices[*it * 3], &indices[*it * 3] + 3);
+            }
+            std::sort(ringFrom.begin(), ringFrom.end());
+            ringFrom.erase(std::unique(ringFrom.begin(), ringFrom.end()), ringFrom.end());
+            std::sort(ringTo.begin(), ringTo.end());
+            ringTo.erase(std::unique(ringTo.begin(), ringTo.end()), ringTo.end());
+            size_t common{};
+            for (auto v : ringFrom) {
+                common += v != c.from && v != c.to && std::binary_search(ringTo.begin(), ringTo.end(), v);
+            }
+            if (common != 2) {
+                continue;
+            }
+
+            // reject collapses that flip a surviving triangle
+            bool flips = false;
+            for (auto it = fromBegin; it != fromEnd && !flips; ++ it) {
+                const unsigned* tri = &indices[*it * 3];
+                if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) {
+                    continue;
+                }
+                glm::vec3 p[3], q[3];
+                for (int k{}; k < 3; k ++) {
+                    p[k] = vertices[tri[k]].Position;
+                    q[k] = tri[k] == c.from ? vertices[c.to].Position : p[k];
+                }
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                flips = glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after);
+            }
+            if (flips) {
+                continue;
+            }
+
+            remap[c.from] = c.to;
+            quadrics[c.to].add(quadrics[c.from]);
+            worst = std::max(worst, c.cost);
+            for (auto v : ringFrom) {
+                touched[v] = 1;
+            }
+            applied ++;
+        }
+        if (applied == 0) {
+            break;
+        }
+
+        // rewrite the index list, dropping triangles that collapsed to a line
+        size_t write{};
+        for (size_t t{}; t < indices.size(); t += 3) {
+            unsigned a = remap[indices[t]], b = remap[indices[t + 1]], c = remap[indices[t + 2]];
+            if (a != b && b != c && a != c) {
+                indices[write ++] = a;
+                indices[write ++] = b;
+                indices[write ++] = c;
+            }
+        }
+        indices.resize(write);
+    }
+
+    if (resultError) {
+        *resultError = static_cast<float>(std::sqrt(worst));
+    }
+    return indices;
+}
+
+void generateLods(MeshData& data, unsigned lodCount) {
+    if (data.lods.empty()) {
+        data.lods.push_back({0, static_cast<uint32_t>(data.indices.size()), 0.0f});
+    }
+    std::vector<unsigned> previous(data.indices.begin() + data.lods.back().firstIndex, data.indices.end());
+    while (data.lods.size() < lodCount) {
+        float error{};
+        auto level = simplifyMesh(previous, data.vertices, previous.size() / 2, FLT_MAX, &error);
+        // not worth a level (locked seams/borders, or already minimal)
+        if (level.empty() || level.size() * 10 > previous.size() * 9) {
+            break;
+        }
+        optimizeVertexCache(level, data.vertices.size());
+        data.lods.push_back({static_cast<uint32_t>(data.indices.size()), static_cast<uint32_t>(level.size()),
+            std::max(error, data.lods.back().error)});
+        data.indices.insert(data.indices.end(), level.begin(), level.end());
+        previous = std::move(level);
+    }
+}
+
+#endif // MESH_OPTIMIZER_H
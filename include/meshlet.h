@@ -0,0 +1,153 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "culling.h"
+#include "mesh.h"
+#include "simd.h"
+
+// clusters of consecutive triangles small enough to cull one by one on the CPU
+constexpr unsigned MESHLET_MAX_VERTICES = 64;
+constexpr unsigned MESHLET_MAX_TRIANGLES = 124;
+
+// meshlets of one index range, structure of arrays so the culling loop loads whole lanes;
+// arrays are padded to a multiple of 8 and only the first count() entries are real
+struct MeshletSet {
+    std::vector<uint32_t> firstIndex, indexCount;
+    std::vector<float> centerX, centerY, centerZ, radius; // bounding sphere
+    std::vector<float> axisX, axisY, axisZ, cutoff;       // normal cone, cutoff > 1 never culls
+
+    size_t count() const { return firstIndex.size(); }
+    bool empty() const { return firstIndex.empty(); }
+};
+
+// split indices (in their current order, ideally cache-optimized) into meshlets of at most
+// MESHLET_MAX_VERTICES unique vertices and MESHLET_MAX_TRIANGLES triangles
+void buildMeshlets(const Vertex* vertices, const unsigned* indices, size_t indexCount, MeshletSet& meshlets);
+
+// indices of meshlets that intersect the frustum and are not entirely backfacing from eye;
+// frustum and eye in the mesh's object space
+void cullMeshlets(const MeshletSet& meshlets, const Frustum& frustum, const glm::vec3& eye, std::vector<uint32_t>& visible);
+
+void buildMeshlets(const Vertex* vertices, const unsigned* indices, size_t indexCount, MeshletSet& meshlets) {
+    meshlets = MeshletSet{};
+    std::vector<unsigned> unique;
+    unique.reserve(MESHLET_MAX_VERTICES);
+
+    auto finish = [&](size_t first, size_t end) {
+        // sphere around the box of the meshlet's vertices
+        glm::vec3 lower = vertices[indices[first]].Position, upper = lower;
+        for (size_t i = first; i < end; i ++) {
+            lower = glm::min(lower, vertices[indices[i]].Position);
+            upper = glm::max(upper, vertices[indices[i]].Position);
+        }
+        glm::vec3 center = (lower + upper) * 0.5f;
+        float radius{};
+        for (size_t i = first; i < end; i ++) {
+            radius = std::max(radius, glm::length(vertices[indices[i]].Position - center));
+        }
+
+        // cone around the area-weighted mean normal; the widest normal sets its half-angle
+        std::vector<glm::vec3> normals;
+        glm::vec3 axis(0.0f);
+        for (size_t i = first; i < end; i += 3) {
+            glm::vec3 a = vertices[indices[i]].Position, b = vertices[indices[i + 1]].Position, c = vertices[indices[i + 2]].Position;
+            glm::vec3 n = glm::cross(b - a, c - a);
+            float length = glm::length(n);
+            if (length > 0.0f) {
+                axis += n;
+                normals.push_back(n / length);
+            }
+        }
+        float axisLength = glm::length(axis);
+        float cutoff = 2.0f;
+        if (axisLength > 0.0f) {
+            axis /= axisLength;
+            float minDot = 1.0f;
+            for (auto& n : normals) {
+                minDot = std::min(minDot, glm::dot(n, axis));
+            }
+            // sin of the half-angle; a cone of 90 degrees or more can never be all backfacing
+            cutoff = minDot <= 0.0f ? 2.0f : std::sqrt(1.0f - minDot * minDot);
+        }
+
+        meshlets.firstIndex.push_back(static_cast<uint32_t>(first));
+        meshlets.indexCount.push_back(static_cast<uint32_t>(end - first));
+        meshlets.centerX.push_back(center.x);
+        meshlets.centerY.push_back(center.y);
+        meshlets.centerZ.push_back(center.z);
+        meshlets.radius.push_back(radius);
+        meshlets.axisX.push_back(axis.x);
+        meshlets.axisY.push_back(axis.y);
+        meshlets.axisZ.push_back(axis.z);
+        meshlets.cutoff.push_back(cutoff);
+    };
+
+    size_t first{};
+    for (size_t t{}; t + 2 < indexCount; t += 3) {
+        size_t added{};
+        for (int k{}; k < 3; k ++) {
+            added += std::find(unique.begin(), unique.end(), indices[t + k]) == unique.end()
+                && std::find(indices + t, indices + t + k, indices[t + k]) == indices + t + k;
+        }
+        if (unique.size() + added > MESHLET_MAX_VERTICES || (t - first) / 3 >= MESHLET_MAX_TRIANGLES) {
+            finish(first, t);
+            first = t;
+            unique.clear();
+        }
+        for (int k{}; k < 3; k ++) {
+            if (std::find(unique.begin(), unique.end(), indices[t + k]) == unique.end()) {
+                unique.push_back(indices[t + k]);
+            }
+        }
+    }
+    if (first + 2 < indexCount) {
+        finish(first, indexCount - indexCount % 3);
+    }
+
+    // pad the lanes for the widest vector loads
+    size_t padded = (meshlets.count() + 7) & ~size_t(7);
+    for (auto* lane : {&meshlets.centerX, &meshlets.centerY, &meshlets.centerZ, &meshlets.radius,
+        &meshlets.axisX, &meshlets.axisY, &meshlets.axisZ, &meshlets.cutoff}) {
+        lane->resize(padded, 0.0f);
+    }
+}
+
+void cullMeshlets(const MeshletSet& meshlets, const Frustum& frustum, const glm::vec3& eye, std::vector<uint32_t>& visible) {
+    visible.clear();
+    size_t count = meshlets.count();
+    SimdFloat eyeX = simdSet(eye.x), eyeY = simdSet(eye.y), eyeZ = simdSet(eye.z);
+    for (size_t i{}; i < count; i += SIMD_WIDTH) {
+        SimdFloat cx = simdLoad(&meshlets.centerX[i]), cy = simdLoad(&meshlets.centerY[i]), cz = simdLoad(&meshlets.centerZ[i]);
+        SimdFloat r = simdLoad(&meshlets.radius[i]);
+        SimdFloat negativeR = simdSet(0.0f) - r;
+
+        // inside (or touching) every plane
+        SimdFloat inside = simdGreaterEqual(simdSet(1.0f), simdSet(0.0f));
+        for (auto& plane : frustum.planes) {
+            SimdFloat distance = simdSet(plane.x) * cx + simdSet(plane.y) * cy + simdSet(plane.z) * cz + simdSet(plane.w);
+            inside = inside & simdGreaterEqual(distance, negativeR);
+        }
+
+        // backfacing when dot(c - eye, axis) >= cutoff * |c - eye| + r
+        SimdFloat vx = cx - eyeX, vy = cy - eyeY, vz = cz - eyeZ;
+        SimdFloat along = vx * simdLoad(&meshlets.axisX[i]) + vy * simdLoad(&meshlets.axisY[i]) + vz * simdLoad(&meshlets.axisZ[i]);
+        SimdFloat distance = simdSqrt(vx * vx + vy * vy + vz * vz);
+        SimdFloat frontfacing = simdLess(along, simdLoad(&meshlets.cutoff[i]) * distance + r);
+
+        unsigned mask = simdMask(inside & frontfacing);
+        for (unsigned lane{}; lane < SIMD_WIDTH && i + lane < count; lane ++) {
+            if (mask & (1u << lane)) {
+                visible.push_back(static_cast<uint32_t>(i + lane));
+            }
+        }
+    }
+}
+
+#endif // MESHLET_H
@@ -15,83 +15,664 @@
 #include <iostream>
 #include <map>
 #include <cstring>
+#include <cctype>
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include "baked_texture.h"
+#include "hash.h"
+#include "mapped_file.h"
 #include "mesh.h"
+#include "mesh_arena.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "meshlet.h"
+#include "occlusion.h"
+#include "scene_graph.h"
+#include "obj_loader.h"
 #include "camera.h"
 #include "shader_s.h"
+#include "texture_cache.h"
+#include "texture_loader.h"
+#include "thread_pool.h"
+#include "trace.h"
 
 unsigned TextureFromFile(const char* path, const std::string& directory, GLint wrapMode, GLint MagFilterMode, GLint MinFilterMode);
 unsigned TextureFromAssimp(const aiTexture* aiTex, GLint wrapMode, GLint MagFilterMode, GLint MinFilterMode);
 
+// post-processing applied on the Assimp path, part of the mesh cache key
+constexpr unsigned MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs;
+
+// conversion passes of our own, the other part of the mesh cache key
+enum ModelProcessFlags : unsigned {
+    MODEL_PROCESS_FAST_OBJ = 1 << 0,
+    MODEL_PROCESS_WELD     = 1 << 1,
+    MODEL_PROCESS_OPTIMIZE = 1 << 2,
+    MODEL_PROCESS_SPLIT16  = 1 << 3,
+    MODEL_PROCESS_LOD_SHIFT = 8, // bits 8..11 hold the LOD count
+};
+
+// a mesh covering at least this fraction of the viewport height draws LOD 0,
+// every halving of its projected size steps one level down
+constexpr float LOD_FULL_DETAIL_FRACTION = 0.5f;
+constexpr unsigned MAX_LOD_COUNT = 5;
+
+// what happens to the CPU copy of vertices/indices once the GL buffers exist
+enum class Residency {
+    Keep,    // stays in Mesh::vertices/indices for the lifetime of the Model
+    Discard, // freed after upload, gone for good
+    Lazy,    // freed after upload, Model::requireGeometry() re-reads it from the cache or source
+};
+
+struct ModelConfig {
+    bool useMeshCache = true;        // load from / write to <path>.meshcache
+    bool asyncTextures = false;      // decode in background, AsyncTextureLoader::poll() uploads them
+    bool fastObjLoader = false;      // parse .obj files with loadObjFast instead of Assimp
+    bool weldVertices = false;       // merge duplicated vertices after conversion (weldVertices)
+    bool optimizeIndices = false;    // vertex cache + overdraw triangle order, pays off once vertices are shared
+    bool packedVertices = false;     // upload 16-byte PackedVertex instead of Vertex, needs model.vs decode
+    bool shortIndices = true;        // split meshes over 65536 vertices when 16-bit indices save memory
+    Residency residency = Residency::Keep;
+    bool consolidateBuffers = false; // all meshes in one MeshArena, drawn per material and node with multi-draw
+    unsigned lodCount = 1;           // levels per mesh including the full one (up to MAX_LOD_COUNT), above 1 also welds
+    bool meshlets = false;           // cluster LOD 0 into meshlets for DrawClusters culling, not with consolidateBuffers
+};
+
+// CPU stage of a Model: what loading produces before the first GL call
+// Model::readData fills it on any thread, Model(const ModelData&) uploads it on the GL thread
+struct ModelData {
+    std::string path;
+    uint64_t sourceHash{};           // 0 when the mesh cache is off
+    SceneGraph nodes;
+    std::vector<MeshData> meshes;
+};
+
 class Model {
 public:
     // model data
     // std::vector<Texture> texture_loader;
+    // per-model path lookup in front of TextureCache, holds a handle to every texture of the model
     std::map<std::string, Texture> texture_loader;
     std::vector<Mesh> meshes;
+    std::unique_ptr<MeshArena> arena; // set with consolidateBuffers, meshes then keep no GL buffers
+    std::vector<MeshletSet> meshlets; // parallel to meshes when config.meshlets is set
+    glm::vec3 boundsCenter{0.0f};     // object-space box around every mesh, node transforms applied
+    glm::vec3 boundsExtent{0.0f};     // refreshed by updateNodes() when a node moved
+    // the source's node hierarchy; animate with nodes.setLocal(), the next Draw with a camera
+    // (or updateNodes()) updates the dirty subtrees; a fast-loaded OBJ has a single identity root
+    SceneGraph nodes;
+    std::vector<uint32_t> meshNodes;  // parallel to meshes
     std::string directory;
     bool gammaCorrection;
+    ModelConfig config;
 
-    Model(std::string const& path, bool gamma = false): gammaCorrection(gamma) {
+    Model(std::string const& path, bool gamma = false, ModelConfig config = {}): gammaCorrection(gamma), config(config) {
         loadModel(path);
     }
+    // GL stage only, from data read earlier, e.g. on a loader thread; the data is not modified
+    Model(const ModelData& data, bool gamma = false, ModelConfig config = {});
+    // CPU stage only: the mesh cache, or an import plus the configured passes (writing the cache);
+    // no GL calls, safe on any thread; embedded textures need the aiScene and are dropped here
+    static bool readData(std::string const& path, const ModelConfig& config, ModelData& data);
     
+    // the mesh vertices as they are: the caller's model uniform, no node transforms
     void Draw(Shader& shader) {
+        if (arena) {
+            arena->Draw(shader);
+            return;
+        }
         for (unsigned i{}; i < meshes.size(); i ++) {
             meshes[i].Draw(shader);
         }
     }
+    // draw the meshes inside the camera frustum, each at a LOD picked from its projected size;
+    // sets the shader's model and NormalMatrix to model times the mesh's node transform
+    void Draw(Shader& shader, const Camera& camera, const glm::mat4& model);
+    // add the coarsest LOD of every mesh as an occluder, meshes without CPU geometry are skipped
+    void renderOccluders(OcclusionBuffer& occlusion, const glm::mat4& model) const;
+    // draw only the meshlets inside the frustum that face the camera; without meshlets, or with
+    // consolidateBuffers, every mesh is drawn whole under model and its node transform
+    void DrawClusters(Shader& shader, const glm::mat4& viewProjection, const glm::vec3& cameraPosition, const glm::mat4& model);
+
+    // nodes.update(), then the model box again if any node changed; returns the nodes updated
+    size_t updateNodes();
+    // bumped every time the model box changes, so instance boxes built from it can tell they are stale
+    uint64_t boundsVersion() const { return boundsUpdates; }
+
+    // make Mesh::vertices/indices available again after a Lazy release, e.g. for picking
+    bool requireGeometry();
+    // delete the GL buffers of every mesh; Mesh has no destructor, so an owner that drops
+    // models while the context lives on (e.g. ModelStreamer) calls this first
+    void releaseBuffers();
 private:
+    bool embeddedTextures = false; // embedded textures need the aiScene, so such models are not cached
+    // where the geometry came from, kept so a Lazy model can re-read it
+    std::string sourcePath;
+    std::string cachePath;
+    uint64_t sourceHash{};
+    unsigned importFlags{};
+    unsigned processFlags{};
+    // per-frame scratch of DrawClusters
+    std::vector<uint32_t> visibleMeshlets;
+    std::vector<GLsizei> rangeCounts;
+    std::vector<uint32_t> rangeFirsts;
+    // object-space mesh boxes, culled by Draw with a camera
+    BoxSet meshBounds;
+    uint64_t boundsUpdates{};
+    std::vector<uint32_t> visibleMeshes;
+    std::vector<unsigned> visibleLods;
+
+    // readData's context: no meshes and no GL objects
+    Model() = default;
+    // directory, cache path and cache key flags of a source file, no file access
+    void setSource(std::string const& path);
     void loadModel(std::string const& path);
-    void processNode(aiNode* node, const aiScene* scene);
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene);
-    std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName, const aiScene* scene);
+    bool loadFromCache();
+    bool importMeshData(Assimp::Importer& importer, std::vector<MeshData>& meshData);
+    void finishLoad();
+    // boundsCenter/Extent from the mesh boxes under the current node world matrices
+    void updateBounds();
+    // node world matrix of a mesh
+    const glm::mat4& meshTransform(size_t mesh) const { return nodes.world(meshNodes[mesh]); }
+    // nodes are numbered in pre-order, as SceneGraph::addAssimpNodes numbers them
+    void processNode(aiNode* node, const aiScene* scene, std::vector<std::pair<aiMesh*, uint32_t>>& nodeMeshes, uint32_t& nextNode);
+    MeshData processMesh(aiMesh* mesh, const aiScene* scene);
+    Mesh uploadMesh(MeshData&& data, const aiScene* scene);
+    // with consolidateBuffers the meshes get no buffers of their own: their geometry goes straight
+    // from the loader's source into the arena (created by the first call), finishLoad builds it
+    void addToArena(Mesh& mesh, const Vertex* vertexData, size_t vertexCount, const unsigned* indexData, uint32_t node);
+    std::vector<TextureRef> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName);
+    Texture loadTexture(std::string const& path, std::string const& typeName, const aiScene* scene);
 };
 
+void Model::setSource(std::string const& path) {
+    // retrieve the diretory path of the filepath
+    directory = path.substr(0, path.find_last_of('/'));
+
+    std::string extension = path.substr(path.find_last_of('.') + 1);
+    for (auto& c : extension) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    bool fastObj = config.fastObjLoader && extension == "obj";
+    // both loaders emit a vertex per face corner, the simplifier would see every vertex as a seam
+    bool weld = config.weldVertices || config.lodCount > 1;
+    // the fast OBJ path never runs Assimp, so its cache entries are keyed with no import flags
+    sourcePath = path;
+    importFlags = fastObj ? 0u : MODEL_IMPORT_FLAGS;
+    processFlags = (fastObj ? MODEL_PROCESS_FAST_OBJ : 0u) | (weld ? MODEL_PROCESS_WELD : 0u)
+        | (config.optimizeIndices ? MODEL_PROCESS_OPTIMIZE : 0u) | (config.shortIndices ? MODEL_PROCESS_SPLIT16 : 0u)
+        | (std::min(config.lodCount, MAX_LOD_COUNT) << MODEL_PROCESS_LOD_SHIFT);
+    cachePath = path + MESH_CACHE_EXTENSION;
+}
+
 // load a model with Assimp supported extension from file and save to mesh vector
 void Model::loadModel(std::string const& path) {
-    // read model with assimp extentions
+    TRACE_SCOPE("Model::loadModel");
+    setSource(path);
+    // warm start: the cache is keyed on the source bytes plus the import flags
+    if (config.useMeshCache) {
+        MappedFile source(path);
+        if (source.isOpen()) {
+            {
+                TRACE_SCOPE("hash source");
+                sourceHash = hashBytes(source.data(), source.size());
+            }
+            if (loadFromCache()) {
+                finishLoad();
+                return;
+            }
+        }
+    }
+
+    std::vector<MeshData> meshData;
     Assimp::Importer importer;
-    // const aiScene* scene = importer.ReadFile(path, aiProcess_CalcTangentSpace | aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_FlipUVs);
-    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+    if (!importMeshData(importer, meshData)) {
+        return;
+    }
+    const aiScene* scene = importer.GetScene();
+    if (scene && scene->mRootNode) {
+        nodes.addAssimpNodes(scene->mRootNode);
+    } else {
+        nodes.addNode(SCENE_NO_PARENT, glm::mat4(1.0f), "root");
+    }
+
+    // GL stage: textures and buffers are created on the context thread
+    meshes.reserve(meshData.size());
+    for (auto& data : meshData) {
+        meshNodes.push_back(data.node < nodes.size() ? data.node : 0);
+        auto& mesh = meshes.emplace_back(uploadMesh(std::move(data), scene));
+        if (config.consolidateBuffers) {
+            addToArena(mesh, mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), meshNodes.back());
+        }
+    }
+
+    if (config.useMeshCache && sourceHash && !embeddedTextures) {
+        if (!writeMeshCache(cachePath, sourceHash, importFlags, processFlags, meshes, meshNodes, nodes)) {
+            std::cerr << "WARNING::MESH_CACHE: failed to write " << cachePath << '\n';
+        }
+    }
+    finishLoad();
+}
+
+Model::Model(const ModelData& data, bool gamma, ModelConfig config): gammaCorrection(gamma), config(config) {
+    setSource(data.path);
+    sourceHash = data.sourceHash;
+    nodes = data.nodes;
+    if (nodes.size() == 0) {
+        nodes.addNode(SCENE_NO_PARENT, glm::mat4(1.0f), "root");
+    }
+    meshes.reserve(data.meshes.size());
+    for (auto& source : data.meshes) {
+        meshNodes.push_back(source.node < nodes.size() ? source.node : 0);
+        std::vector<Texture> textures;
+        for (auto& ref : source.textures) {
+            textures.push_back(loadTexture(ref.path, ref.type, nullptr));
+        }
+        // uploaded from the caller's copy, which it may keep or drop
+        auto& mesh = meshes.emplace_back(source.vertices.data(), source.vertices.size(), source.indices.data(), source.indices.size(),
+            std::move(textures), source.material, config.packedVertices ? VertexFormat::Packed : VertexFormat::Float, !config.consolidateBuffers);
+        if (config.residency == Residency::Keep || config.meshlets) {
+            mesh.vertices = source.vertices;
+            mesh.indices = source.indices;
+        }
+        if (!source.lods.empty()) {
+            mesh.lods = source.lods;
+        }
+        if (config.consolidateBuffers) {
+            addToArena(mesh, source.vertices.data(), source.vertices.size(), source.indices.data(), meshNodes.back());
+        }
+    }
+    finishLoad();
+}
+
+bool Model::readData(std::string const& path, const ModelConfig& config, ModelData& data) {
+    TRACE_SCOPE("Model::readData");
+    Model loader;
+    loader.config = config;
+    loader.setSource(path);
+    data = {};
+    data.path = path;
+    if (config.useMeshCache) {
+        MappedFile source(path);
+        if (source.isOpen()) {
+            loader.sourceHash = hashBytes(source.data(), source.size());
+        }
+    }
+    data.sourceHash = loader.sourceHash;
+
+    // the cache is copied out here, the mapping does not outlive the reader
+    MeshCacheReader reader;
+    if (loader.sourceHash && reader.open(loader.cachePath, loader.sourceHash, loader.importFlags, loader.processFlags)) {
+        reader.readNodes(data.nodes);
+        data.meshes.resize(reader.meshCount());
+        for (unsigned i{}; i < reader.meshCount(); i ++) {
+            auto& entry = reader.entry(i);
+            auto& mesh = data.meshes[i];
+            mesh.vertices.assign(reader.vertices(i), reader.vertices(i) + entry.vertexCount);
+            mesh.indices.assign(reader.indices(i), reader.indices(i) + entry.indexCount);
+            mesh.textures = reader.textures(i);
+            mesh.material = entry.material;
+            mesh.node = entry.node;
+            if (entry.lodCount) {
+                mesh.lods = reader.lods(i);
+            }
+        }
+        return true;
+    }
+
+    Assimp::Importer importer;
+    if (!loader.importMeshData(importer, data.meshes)) {
+        return false;
+    }
+    const aiScene* scene = importer.GetScene();
+    if (scene && scene->mRootNode) {
+        data.nodes.addAssimpNodes(scene->mRootNode);
+    } else {
+        data.nodes.addNode(SCENE_NO_PARENT, glm::mat4(1.0f), "root");
+    }
+    bool embedded = scene && scene->mNumTextures > 0;
+    if (embedded) {
+        std::cerr << "WARNING::MODEL: embedded textures of " << path << " are not kept without the aiScene\n";
+    }
+    if (loader.sourceHash && !embedded) {
+        std::vector<uint32_t> meshNodes;
+        for (auto& mesh : data.meshes) {
+            meshNodes.push_back(mesh.node);
+        }
+        if (!writeMeshCache(loader.cachePath, loader.sourceHash, loader.importFlags, loader.processFlags, data.meshes, meshNodes, data.nodes)) {
+            std::cerr << "WARNING::MESH_CACHE: failed to write " << loader.cachePath << '\n';
+        }
+    }
+    return true;
+}
+
+// CPU stage: parse the source and run the configured passes, no GL calls
+bool Model::importMeshData(Assimp::Importer& importer, std::vector<MeshData>& meshData) {
+    std::string const& path = sourcePath;
+    if (processFlags & MODEL_PROCESS_FAST_OBJ) {
+        if (!loadObjFast(path, meshData)) {
+            std::cerr << "ERROR::OBJ_LOADER: failed to read " << path << '\n';
+            return false;
+        }
+    } else {
+        // read model with assimp extentions
+        // const aiScene* scene = importer.ReadFile(path, aiProcess_CalcTangentSpace | aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_FlipUVs);
+        // parse and post-processing as two steps, the same result as ReadFile(path, importFlags) but traced apart
+        const aiScene* scene;
+        {
+            TRACE_SCOPE("Assimp parse");
+            scene = importer.ReadFile(path, 0);
+        }
+        if (scene) {
+            TRACE_SCOPE("Assimp post-processing");
+            scene = importer.ApplyPostProcessing(importFlags);
+        }
+
+        // check for errors
+        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) { // null
+            std::cerr << "ERROR::ASSIMP: " << importer.GetErrorString() << '\n';
+            return false;
+        }
+
+        // process ASSIMP's root node recursively
+        std::vector<std::pair<aiMesh*, uint32_t>> nodeMeshes;
+        uint32_t nextNode{};
+        processNode(scene->mRootNode, scene, nodeMeshes, nextNode);
+
+        // CPU stage: one aiMesh per task on the worker pool, slots keep the node order
+        meshData.resize(nodeMeshes.size());
+        ThreadPool::global().parallelFor(nodeMeshes.size(), [&](size_t i) {
+            meshData[i] = processMesh(nodeMeshes[i].first, scene);
+            meshData[i].node = nodeMeshes[i].second;
+        });
+    }
+
+    // optional CPU passes, each mesh on its own task
+    ThreadPool::global().parallelFor(meshData.size(), [&](size_t i) {
+        TRACE_SCOPE("weld + optimize");
+        if (processFlags & MODEL_PROCESS_WELD) {
+            weldVertices(meshData[i]);
+        }
+        if (config.optimizeIndices) {
+            optimizeVertexCache(meshData[i].indices, meshData[i].vertices.size());
+            optimizeOverdraw(meshData[i].indices, meshData[i].vertices);
+        }
+    });
+    if (config.shortIndices) {
+        std::vector<std::vector<MeshData>> parts(meshData.size());
+        ThreadPool::global().parallelFor(meshData.size(), [&](size_t i) {
+            TRACE_SCOPE("splitForShortIndices");
+            parts[i] = splitForShortIndices(std::move(meshData[i]));
+        });
+        meshData.clear();
+        for (auto& part : parts) {
+            std::move(part.begin(), part.end(), std::back_inserter(meshData));
+        }
+    }
+    // LODs last, they index the final vertex buffer of each part
+    if (config.lodCount > 1) {
+        ThreadPool::global().parallelFor(meshData.size(), [&](size_t i) {
+            TRACE_SCOPE("generateLods");
+            generateLods(meshData[i], std::min(config.lodCount, MAX_LOD_COUNT));
+        });
+        size_t shortMeshes = std::count_if(meshData.begin(), meshData.end(), [&](const MeshData& data) {
+            return data.lods.size() < std::min(config.lodCount, MAX_LOD_COUNT);
+        });
+        if (shortMeshes) {
+            std::cerr << "WARNING::MODEL: " << shortMeshes << " of " << meshData.size() << " meshes of " << path
+                << " stopped short of " << std::min(config.lodCount, MAX_LOD_COUNT) << " LOD levels (seams, borders or too few triangles)\n";
+        }
+    }
+    return true;
+}
+
+size_t Model::updateNodes() {
+    size_t updated = nodes.update();
+    if (updated) {
+        updateBounds();
+    }
+    return updated;
+}
+
+void Model::Draw(Shader& shader, const Camera& camera, const glm::mat4& model) {
+    updateNodes();
+    // world boxes under the node transforms; meshes outside the view are skipped
+    meshBounds.clear();
+    for (size_t i{}; i < meshes.size(); i ++) {
+        meshBounds.push(meshes[i].boundsCenter, meshes[i].boundsExtent, model * meshTransform(i));
+    }
+    cullBoxes(meshBounds, camera.frustum(), visibleMeshes);
+    visibleLods.clear();
+    for (auto m : visibleMeshes) {
+        auto& mesh = meshes[m];
+        glm::mat4 meshModel = model * meshTransform(m);
+        unsigned lod{};
+        if (mesh.lods.size() > 1) {
+            // the largest axis scale bounds how much the matrix grows the bounding sphere
+            float scale = std::max({glm::length(glm::vec3(meshModel[0])), glm::length(glm::vec3(meshModel[1])), glm::length(glm::vec3(meshModel[2]))});
+            glm::vec3 center(meshModel * glm::vec4(mesh.boundsCenter, 1.0f));
+            float fraction = camera.screenFraction(center, mesh.boundsRadius * scale);
+            if (fraction < LOD_FULL_DETAIL_FRACTION) {
+                lod = static_cast<unsigned>(std::log2(LOD_FULL_DETAIL_FRACTION / std::max(fraction, 1e-6f)));
+            }
+        }
+        visibleLods.push_back(lod);
+    }
 
-    // check for errors
-    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) { // null
-        std::cout << "ERROR::ASSIMP: " << importer.GetErrorString() << '\n';
+    // arena ranges are in mesh order, the visible ones at their LODs go out as per-material multi-draws
+    if (arena) {
+        arena->Draw(shader, model, nodes, visibleMeshes, visibleLods);
         return;
     }
+    for (size_t i{}; i < visibleMeshes.size(); i ++) {
+        auto m = visibleMeshes[i];
+        setModelMatrix(shader, model * meshTransform(m));
+        meshes[m].Draw(shader, visibleLods[i]);
+    }
+}
 
-    // retrieve the diretory path of the filepath
-    directory = path.substr(0, path.find_last_of('/'));
-    // process ASSIMP's root node recursively
-    processNode(scene->mRootNode, scene); 
+void Model::renderOccluders(OcclusionBuffer& occlusion, const glm::mat4& model) const {
+    for (size_t i{}; i < meshes.size(); i ++) {
+        auto& mesh = meshes[i];
+        if (!mesh.hasGeometry()) {
+            continue;
+        }
+        // a few hundred pixels across gain nothing from full detail
+        auto& level = mesh.lods.back();
+        occlusion.addOccluder(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data() + level.firstIndex, level.indexCount,
+            model * meshTransform(i));
+    }
 }
 
-// process a node recursively
-void Model::processNode(aiNode* node, const aiScene* scene) {
+void Model::DrawClusters(Shader& shader, const glm::mat4& viewProjection, const glm::vec3& cameraPosition, const glm::mat4& model) {
+    updateNodes();
+    // no meshlets, or an arena whose meshes have no index buffers of their own to draw ranges from:
+    // everything, placed under the caller's model and the node transforms like the culled path
+    if (arena || meshlets.size() != meshes.size()) {
+        if (arena) {
+            arena->Draw(shader, model, nodes);
+            return;
+        }
+        for (size_t i{}; i < meshes.size(); i ++) {
+            setModelMatrix(shader, model * meshTransform(i));
+            meshes[i].Draw(shader);
+        }
+        return;
+    }
+    for (size_t i{}; i < meshes.size(); i ++) {
+        // cull in object space: planes of the full matrix, eye through the inverse model matrix
+        glm::mat4 meshModel = model * meshTransform(i);
+        setModelMatrix(shader, meshModel);
+        Frustum frustum = Frustum::fromMatrix(viewProjection * meshModel);
+        glm::vec3 eye(glm::inverse(meshModel) * glm::vec4(cameraPosition, 1.0f));
+        cullMeshlets(meshlets[i], frustum, eye, visibleMeshlets);
+        // neighbouring visible meshlets are contiguous in the index buffer, merge them into one range
+        rangeCounts.clear();
+        rangeFirsts.clear();
+        for (auto m : visibleMeshlets) {
+            uint32_t first = meshlets[i].firstIndex[m], count = meshlets[i].indexCount[m];
+            if (!rangeFirsts.empty() && rangeFirsts.back() + static_cast<uint32_t>(rangeCounts.back()) == first) {
+                rangeCounts.back() += count;
+            } else {
+                rangeFirsts.push_back(first);
+                rangeCounts.push_back(count);
+            }
+        }
+        meshes[i].DrawRanges(shader, rangeCounts.data(), rangeFirsts.data(), static_cast<GLsizei>(rangeCounts.size()));
+    }
+}
+
+// build meshes from a mapped cache file, return false on a miss
+bool Model::loadFromCache() {
+    TRACE_SCOPE("Model::loadFromCache");
+    MeshCacheReader reader;
+    if (!reader.open(cachePath, sourceHash, importFlags, processFlags)) {
+        return false;
+    }
+
+    reader.readNodes(nodes);
+    if (nodes.size() == 0) {
+        nodes.addNode(SCENE_NO_PARENT, glm::mat4(1.0f), "root");
+    }
+    meshes.reserve(reader.meshCount());
+    for (unsigned i{}; i < reader.meshCount(); i ++) {
+        auto& entry = reader.entry(i);
+        meshNodes.push_back(entry.node < nodes.size() ? entry.node : 0);
+        std::vector<Texture> textures;
+        for (auto& ref : reader.textures(i)) {
+            textures.push_back(loadTexture(ref.path, ref.type, nullptr));
+        }
+        auto& mesh = meshes.emplace_back(reader.vertices(i), entry.vertexCount, reader.indices(i), entry.indexCount, std::move(textures),
+            entry.material, config.packedVertices ? VertexFormat::Packed : VertexFormat::Float, !config.consolidateBuffers);
+        // the mapping goes away with the reader, copy out of it only when something reads the copy
+        if (config.residency == Residency::Keep || config.meshlets) {
+            mesh.vertices.assign(reader.vertices(i), reader.vertices(i) + entry.vertexCount);
+            mesh.indices.assign(reader.indices(i), reader.indices(i) + entry.indexCount);
+        }
+        if (entry.lodCount) {
+            mesh.lods = reader.lods(i);
+        }
+        if (config.consolidateBuffers) {
+            addToArena(mesh, reader.vertices(i), entry.vertexCount, reader.indices(i), meshNodes.back());
+        }
+    }
+    return true;
+}
+
+// last steps shared by the cache and the import path: consolidation, then the residency policy
+void Model::finishLoad() {
+    TRACE_SCOPE("Model::finishLoad");
+    updateBounds();
+
+    if (config.meshlets && arena) {
+        std::cerr << "WARNING::MODEL: meshlets need per-mesh buffers, " << sourcePath << " is drawn whole with consolidateBuffers\n";
+    } else if (config.meshlets) {
+        meshlets.resize(meshes.size());
+        ThreadPool::global().parallelFor(meshes.size(), [&](size_t i) {
+            auto& mesh = meshes[i];
+            buildMeshlets(mesh.vertices.data(), mesh.indices.data() + mesh.lods[0].firstIndex, mesh.lods[0].indexCount, meshlets[i]);
+            // meshlet ranges are relative to LOD 0, which always starts at index 0
+        });
+    }
+    if (arena) {
+        arena->build();
+    }
+    if (config.residency != Residency::Keep) {
+        for (auto& mesh : meshes) {
+            mesh.releaseGeometry();
+        }
+    }
+}
+
+void Model::updateBounds() {
+    meshBounds.clear();
+    glm::vec3 lower(0.0f), upper(0.0f);
+    for (size_t i{}; i < meshes.size(); i ++) {
+        meshBounds.push(meshes[i].boundsCenter, meshes[i].boundsExtent, meshTransform(i));
+        glm::vec3 center(meshBounds.centerX[i], meshBounds.centerY[i], meshBounds.centerZ[i]);
+        glm::vec3 extent(meshBounds.extentX[i], meshBounds.extentY[i], meshBounds.extentZ[i]);
+        lower = i ? glm::min(lower, center - extent) : center - extent;
+        upper = i ? glm::max(upper, center + extent) : center + extent;
+    }
+    boundsCenter = (lower + upper) * 0.5f;
+    boundsExtent = (upper - lower) * 0.5f;
+    boundsUpdates ++;
+}
+
+bool Model::requireGeometry() {
+    bool resident = std::all_of(meshes.begin(), meshes.end(), [](const Mesh& mesh) { return mesh.hasGeometry(); });
+    if (resident) {
+        return true;
+    }
+    if (config.residency != Residency::Lazy) {
+        return false;
+    }
+
+    // cheapest first: the mesh cache, if it still matches what was loaded
+    MeshCacheReader reader;
+    if (sourceHash && reader.open(cachePath, sourceHash, importFlags, processFlags) && reader.meshCount() == meshes.size()) {
+        for (unsigned i{}; i < reader.meshCount(); i ++) {
+            auto& entry = reader.entry(i);
+            meshes[i].vertices.assign(reader.vertices(i), reader.vertices(i) + entry.vertexCount);
+            meshes[i].indices.assign(reader.indices(i), reader.indices(i) + entry.indexCount);
+        }
+        return true;
+    }
+
+    // otherwise run the CPU stage again; it is deterministic, so meshes line up with the GL buffers
+    if (sourceHash) {
+        MappedFile source(sourcePath);
+        if (!source.isOpen() || hashBytes(source.data(), source.size()) != sourceHash) {
+            std::cerr << "ERROR::MODEL: " << sourcePath << " changed since it was loaded\n";
+            return false;
+        }
+    }
+    std::vector<MeshData> meshData;
+    Assimp::Importer importer;
+    if (!importMeshData(importer, meshData) || meshData.size() != meshes.size()) {
+        return false;
+    }
+    for (size_t i{}; i < meshes.size(); i ++) {
+        meshes[i].vertices = std::move(meshData[i].vertices);
+        meshes[i].indices = std::move(meshData[i].indices);
+    }
+    return true;
+}
+
+void Model::releaseBuffers() {
+    for (auto& mesh : meshes) {
+        mesh.releaseBuffers();
+    }
+    arena.reset();
+}
+
+// process a node recursively, collecting its meshes in draw order
+void Model::processNode(aiNode* node, const aiScene* scene, std::vector<std::pair<aiMesh*, uint32_t>>& nodeMeshes, uint32_t& nextNode) {
+    uint32_t id = nextNode ++;
     // process each mesh located at the current node
     for (unsigned i{}; i < node->mNumMeshes; i ++) {
         // scene contains all the data; node only contains indices(index)
-        auto mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+        nodeMeshes.emplace_back(scene->mMeshes[node->mMeshes[i]], id);
     }
     // after that, process each of the children nodes
     for (unsigned i{}; i < node->mNumChildren; i ++) {
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], scene, nodeMeshes, nextNode);
     }
 }
 
-// return a Mesh object created from extracted mesh data
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
+// extract vertices, indices and material of a mesh; no GL calls, runs on worker threads
+MeshData Model::processMesh(aiMesh* mesh, const aiScene* scene) {
+    TRACE_SCOPE("processMesh");
     // data to fill
-    std::vector<Vertex> vertices;
-    std::vector<unsigned> indices;
-    std::vector<Texture> textures;
-    Material meshMaterials;
+    MeshData data;
+    auto& vertices = data.vertices;
+    auto& indices = data.indices;
+    auto& textures = data.textures;
+    auto& meshMaterials = data.material;
+    vertices.reserve(mesh->mNumVertices);
+    indices.reserve(mesh->mNumFaces * 3);
 
     // walk through each of the mesh vertices
     for (unsigned i{}; i < mesh->mNumVertices; i ++) {
@@ -151,7 +732,7 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
         // material color detect
         aiColor4D diffuse, ambient, specular;
         if (aiGetMaterialColor(material, AI_MATKEY_COLOR_DIFFUSE, &diffuse) == AI_SUCCESS) {
-            meshMaterials.mDiffuse = glm::vec3(diffuse.r, diffuse.g, diffuse.g);
+            meshMaterials.mDiffuse = glm::vec3(diffuse.r, diffuse.g, diffuse.b);
         } else {
             meshMaterials.mDiffuse = glm::vec3(0.5f, 0.5f, 0.5f);
         }
@@ -168,10 +749,10 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
 
         // Types with number N defined in mesh.h
         // 1. diffuse maps
-        auto diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", scene);
+        auto diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
         textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
         // 2. specular maps
-        auto specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", scene);
+        auto specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
         textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
         // // 3. normal maps
         // auto normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", scene);
@@ -180,15 +761,35 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
         // auto heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", scene);
         // textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
     // }
-    return Mesh(vertices, indices, textures, meshMaterials);
+    return data;
 }
 
-// check all material textures and load if not
-std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName, const aiScene* scene) {
+// resolve textures and create the GL buffers for converted mesh data
+Mesh Model::uploadMesh(MeshData&& data, const aiScene* scene) {
+    TRACE_SCOPE("Model::uploadMesh");
     std::vector<Texture> textures;
+    for (auto& ref : data.textures) {
+        textures.push_back(loadTexture(ref.path, ref.type, scene));
+    }
+    Mesh mesh(std::move(data.vertices), std::move(data.indices), std::move(textures), data.material,
+        config.packedVertices ? VertexFormat::Packed : VertexFormat::Float, !config.consolidateBuffers);
+    if (!data.lods.empty()) {
+        mesh.lods = std::move(data.lods);
+    }
+    return mesh;
+}
+
+void Model::addToArena(Mesh& mesh, const Vertex* vertexData, size_t vertexCount, const unsigned* indexData, uint32_t node) {
+    if (!arena) {
+        arena = std::make_unique<MeshArena>(config.packedVertices ? VertexFormat::Packed : VertexFormat::Float);
+    }
+    arena->add(mesh, vertexData, vertexCount, indexData, node);
+}
+
+// list all material textures, they are loaded later on the GL thread
+std::vector<TextureRef> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName) {
+    std::vector<TextureRef> textures;
     // std::cout << mat->GetTextureCount(type) << '\n';
-    if (mat->GetTextureCount(type) != 0)
-        std::cout << typeName << '\n';
     
     // if (mat->GetTextureCount(type) == 0 && type == aiTextureType_DIFFUSE) {
     //     Texture texture;
@@ -212,50 +813,79 @@ std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType
         //         break;
         //     }
         // }
-        auto to_find = texture_loader.find(str.C_Str());
-        if (to_find != texture_loader.end()) {
-            textures.push_back(to_find->second);
-        } else { // not loaded, load it
-            Texture texture;
-            auto path = str.C_Str();
-            auto aitexture = scene->GetEmbeddedTexture(path);
-            if (aitexture) {
-                texture.id = TextureFromAssimp(aitexture, GL_CLAMP, GL_LINEAR, GL_LINEAR);
-            } else {    
-                texture.id = TextureFromFile(str.C_Str(), directory, GL_REPEAT, GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR);
-            }
-            // texture.id = TextureFromFile(str.C_Str(), directory, GL_REPEAT, GL_LINEAR, GL_LINEAR);
-            texture.path = str.C_Str();
-            texture.type = typeName;
-            textures.push_back(texture);
-            // texture_loader.push_back(texture);
-            texture_loader[str.C_Str()] = texture;
-        }
+        textures.push_back({typeName, str.C_Str()});
     }
     return textures;
 }
 
+// return the loaded texture for path, load it if not
+Texture Model::loadTexture(std::string const& path, std::string const& typeName, const aiScene* scene) {
+    auto to_find = texture_loader.find(path);
+    if (to_find != texture_loader.end()) {
+        return to_find->second;
+    }
+
+    // shared across models by content, so the same atlas is decoded and uploaded once
+    Texture texture;
+    auto& cache = TextureCache::global();
+    auto aitexture = scene ? scene->GetEmbeddedTexture(path.c_str()) : nullptr;
+    if (aitexture) {
+        // one sampler for both paths, so a sync and an async model share the upload
+        SamplerParams sampler{GL_CLAMP_TO_EDGE, GL_LINEAR, GL_LINEAR};
+        texture.handle = cache.acquire(cache.embeddedKey(aitexture), sampler, [&] {
+            if (config.asyncTextures) {
+                return AsyncTextureLoader::global().requestAssimp(aitexture, sampler.wrapMode, sampler.magFilter, sampler.minFilter);
+            }
+            return std::make_shared<TextureResource>(TextureFromAssimp(aitexture, sampler.wrapMode, sampler.magFilter, sampler.minFilter));
+        });
+        embeddedTextures = true;
+    } else {
+        SamplerParams sampler{GL_REPEAT, GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR};
+        texture.handle = cache.acquire(cache.fileKey(directory + "/" + path), sampler, [&] {
+            if (config.asyncTextures) {
+                return AsyncTextureLoader::global().requestFile(directory + "/" + path, sampler.wrapMode, sampler.magFilter, sampler.minFilter);
+            }
+            return std::make_shared<TextureResource>(TextureFromFile(path.c_str(), directory, sampler.wrapMode, sampler.magFilter, sampler.minFilter));
+        });
+    }
+    texture.path = path;
+    texture.type = typeName;
+    // texture_loader.push_back(texture);
+    texture_loader[path] = texture;
+    return texture;
+}
+
 unsigned TextureFromFile(const char* path, const std::string& directory, GLint wrapMode, GLint MagFilterMode, GLint MinFilterMode) {
     std::string fileName(path);
     fileName = directory + "/" + fileName;
-    std::cout << fileName << '\n';
 
     // load texture
     unsigned textureID{};
     glGenTextures(1, &textureID);
 
+    // baked mip chain: no decode and no glGenerateMipmap
+    BakedTexture baked;
+    if (loadBakedTexture(fileName, baked)) {
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, MinFilterMode);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, MagFilterMode);
+        baked.upload();
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return textureID;
+    }
+
     int width, height, nrComponents;
-    unsigned char* data = stbi_load(fileName.c_str(), &width, &height, &nrComponents, 0);
+    unsigned char* data;
+    {
+        TRACE_SCOPE("stbi_load");
+        data = stbi_load(fileName.c_str(), &width, &height, &nrComponents, 0);
+    }
 
     if (data) {
-        GLenum format = GL_RGB;
-        if (nrComponents == 1) {
-            format = GL_RED;    
-        } else if (nrComponents == 3) {
-            format = GL_RGB;
-        } else if (nrComponents == 4) {
-            format = GL_RGBA;
-        }
+        // the same mapping as AsyncTextureLoader, grey+alpha included
+        GLenum format = formatFromChannels(nrComponents);
 
         glBindTexture(GL_TEXTURE_2D, textureID);
 
@@ -264,10 +894,21 @@ unsigned TextureFromFile(const char* path, const std::string& directory, GLint w
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, MinFilterMode);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, MagFilterMode);
 
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        {
+            TRACE_SCOPE("glTexImage2D");
+            // stbi rows are tightly packed, 1-3 channel rows need not be 4-byte aligned
+            GLint alignment;
+            glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+        }
+        {
+            TRACE_SCOPE("glGenerateMipmap");
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
     } else {
-        std::cout << "Texture failed to load at path: " << path << '\n';
+        std::cerr << "Texture failed to load at path: " << path << '\n';
     }
     stbi_image_free(data);
     glBindTexture(GL_TEXTURE_2D, 0);
@@ -299,13 +940,7 @@ unsigned TextureFromAssimp(const aiTexture* aiTex, GLint wrapMode, GLint MagFilt
 	}
 
 	if (image_data != nullptr) {
-		GLenum format = GL_RGB;
-		if (nrChannels == 1)
-			format = GL_RED;
-		else if (nrChannels == 3)
-			format = GL_RGB;
-		else if (nrChannels == 4)
-			format = GL_RGBA;
+		GLenum format = formatFromChannels(nrChannels);
 		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, image_data);
 	}
 
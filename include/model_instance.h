@@ -0,0 +1,155 @@
+#ifndef MODEL_INSTANCE_H
+#define MODEL_INSTANCE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "culling.h"
+#include "model.h"
+#include "occlusion.h"
+#include "shader_s.h"
+
+// many copies of one shared Model: per-instance matrices (InstanceData) live in one buffer and
+// every Mesh is drawn once with glDrawElementsInstanced, whatever the instance count;
+// the shader's model matrix goes over every instance, so the whole set moves without an upload
+class ModelInstance {
+public:
+    std::vector<glm::mat4> transforms; // edit, then upload()
+    size_t occluderCount = 16;         // nearest visible instances rasterized as occluders
+
+    // the model is shared, not owned, and must outlive the instance set; both own GL buffers and
+    // must be destroyed before glfwTerminate()
+    explicit ModelInstance(Model& model);
+    ~ModelInstance();
+    ModelInstance(const ModelInstance&) = delete;
+    ModelInstance& operator=(const ModelInstance&) = delete;
+
+    // copy transforms to the GPU and rebuild the world boxes, call after changing them;
+    // the boxes are also rebuilt by Draw when the model's node animation changed its box
+    void upload();
+    void Draw(Shader& shader);
+    // draw only the instances whose box intersects the frustum: Camera::frustum() with an identity
+    // model matrix, Frustum::fromMatrix(projection * view * model) for the set's own space;
+    // with an occlusion buffer (cleared this frame, identity model only) the nearest ones are also
+    // rasterized into it and instances hidden behind them are skipped
+    void Draw(Shader& shader, const Frustum& frustum, OcclusionBuffer* occlusion = nullptr);
+
+    // instances that passed the last frustum test
+    size_t visibleCount() const { return visible.size(); }
+private:
+    Model& model;
+    unsigned instanceVBO = 0;
+    size_t capacity = 0;     // instances the buffer has storage for
+    GLsizei uploaded = 0;    // instances in the buffer right now
+    // world boxes of the instances and the transforms that survive culling, streamed each frame
+    BoxSet bounds;
+    uint64_t boundsVersion{}; // Model::boundsVersion() the boxes were built from
+    std::vector<uint32_t> visible;
+    std::vector<std::pair<float, uint32_t>> occluders;
+    std::vector<InstanceData> instances, visibleInstances; // uploaded transforms with their normal matrices
+    unsigned visibleVBO = 0;
+    size_t visibleCapacity = 0;
+
+    static void stream(unsigned buffer, size_t& bufferCapacity, const std::vector<InstanceData>& data);
+    void updateBounds();
+    void drawBuffer(Shader& shader, unsigned buffer, GLsizei count);
+};
+
+ModelInstance::ModelInstance(Model& model): model(model) {
+    glGenBuffers(1, &instanceVBO);
+    glGenBuffers(1, &visibleVBO);
+}
+
+ModelInstance::~ModelInstance() {
+    if (instanceVBO && glfwGetCurrentContext()) {
+        glDeleteBuffers(1, &instanceVBO);
+        glDeleteBuffers(1, &visibleVBO);
+    }
+}
+
+void ModelInstance::stream(unsigned buffer, size_t& bufferCapacity, const std::vector<InstanceData>& data) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (data.size() > bufferCapacity) {
+        // grow geometrically so a slowly growing instance count does not reallocate every frame
+        bufferCapacity = std::max(data.size(), bufferCapacity * 2);
+    }
+    // fresh storage (orphaning) so a draw still reading the old one does not stall the upload
+    glBufferData(GL_ARRAY_BUFFER, bufferCapacity * sizeof(InstanceData), nullptr, GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, data.size() * sizeof(InstanceData), data.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ModelInstance::upload() {
+    instances.resize(transforms.size());
+    for (size_t i{}; i < transforms.size(); i ++) {
+        instances[i] = InstanceData(transforms[i]);
+    }
+    stream(instanceVBO, capacity, instances);
+    uploaded = static_cast<GLsizei>(instances.size());
+    updateBounds();
+}
+
+// from the uploaded matrices, not transforms: those may have been edited since upload()
+void ModelInstance::updateBounds() {
+    bounds.clear();
+    for (auto& instance : instances) {
+        bounds.push(model.boundsCenter, model.boundsExtent, instance.model);
+    }
+    boundsVersion = model.boundsVersion();
+}
+
+void ModelInstance::drawBuffer(Shader& shader, unsigned buffer, GLsizei count) {
+    if (count == 0) {
+        return;
+    }
+    // the shared node transforms go under every instance matrix, as Model::Draw applies them
+    model.updateNodes();
+    if (model.arena) {
+        model.arena->DrawInstanced(shader, buffer, count, model.nodes);
+        return;
+    }
+    for (size_t i{}; i < model.meshes.size(); i ++) {
+        setNodeMatrix(shader, model.nodes.world(model.meshNodes[i]));
+        model.meshes[i].DrawInstanced(shader, buffer, count);
+    }
+}
+
+void ModelInstance::Draw(Shader& shader) {
+    drawBuffer(shader, instanceVBO, uploaded);
+}
+
+void ModelInstance::Draw(Shader& shader, const Frustum& frustum, OcclusionBuffer* occlusion) {
+    // cull and rasterize occluders with this frame's node transforms, not last frame's
+    model.updateNodes();
+    if (boundsVersion != model.boundsVersion()) {
+        updateBounds();
+    }
+    cullBoxes(bounds, frustum, visible);
+    if (occlusion) {
+        occluders.clear();
+        for (auto i : visible) {
+            occluders.emplace_back(occlusion->viewDepth(glm::vec3(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i])), i);
+        }
+        size_t count = std::min(occluderCount, occluders.size());
+        std::partial_sort(occluders.begin(), occluders.begin() + count, occluders.end());
+        for (size_t k{}; k < count; k ++) {
+            model.renderOccluders(*occlusion, instances[occluders[k].second].model);
+        }
+        occlusion->rasterize();
+        occlusion->filterVisible(bounds, visible);
+    }
+    if (visible.size() == static_cast<size_t>(uploaded)) {
+        drawBuffer(shader, instanceVBO, uploaded);
+        return;
+    }
+    visibleInstances.resize(visible.size());
+    for (size_t i{}; i < visible.size(); i ++) {
+        visibleInstances[i] = instances[visible[i]];
+    }
+    stream(visibleVBO, visibleCapacity, visibleInstances);
+    drawBuffer(shader, visibleVBO, static_cast<GLsizei>(visibleInstances.size()));
+}
+
+#endif // MODEL_INSTANCE_H
@@ -0,0 +1,374 @@
+#ifndef MODEL_STREAMER_H
+#define MODEL_STREAMER_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "camera.h"
+#include "culling.h"
+#include "model.h"
+#include "shader_s.h"
+#include "texture_cache.h"
+#include "thread_pool.h"
+
+struct StreamingConfig {
+    size_t ramBudget = size_t(1) << 30;            // CPU copies of read models (ModelData)
+    size_t vramBudget = size_t(512) << 20;         // mesh buffers plus textures of uploaded models
+    size_t uploadBytesPerFrame = size_t(32) << 20; // GL uploads per update(), the first one always goes through
+    float minScreenFraction = 0.02f;               // models whose bounding sphere covers less of the view height are not wanted
+    float lookAhead = 1.0f;                        // seconds of camera motion that are prefetched
+    unsigned ioThreads = 2;                        // background readers
+    unsigned maxInFlight = 4;                      // reads queued at once; a deeper queue would fix priorities too early
+};
+
+// scenes larger than memory: many models placed in the world, each read on background threads,
+// uploaded and evicted as the camera moves; priority is the projected size of a model's bounds
+// now or lookAhead seconds ahead (doubled inside the frustum), eviction is least recently wanted
+// first, under separate budgets for the CPU copies and for what is on the GPU
+// textures go through AsyncTextureLoader, so poll() it every frame as usual
+class ModelStreamer {
+public:
+    // modelConfig applies to every model; asyncTextures is forced on and residency to Discard,
+    // the streamer's ModelData is the CPU copy; meshlets and LODs are built on the GL thread, so keep them cached
+    explicit ModelStreamer(StreamingConfig config = {}, ModelConfig modelConfig = {});
+    ~ModelStreamer();
+    ModelStreamer(const ModelStreamer&) = delete;
+    ModelStreamer& operator=(const ModelStreamer&) = delete;
+
+    // place a model file; its object-space bounds must be known up front (e.g. from a tile index),
+    // nothing is read until the camera gets close; returns the model's index
+    size_t add(const std::string& path, const glm::mat4& transform, const glm::vec3& boundsCenter, const glm::vec3& boundsExtent);
+
+    // once per frame on the GL thread, before Draw: take finished reads, start new ones,
+    // upload within uploadBytesPerFrame and evict whatever is over budget
+    void update(const Camera& camera, float deltaTime);
+    // draw the uploaded models inside the frustum of the last update
+    void Draw(Shader& shader, const Camera& camera);
+
+    size_t size() const { return entries.size(); }
+    // null while the model is not on the GPU
+    Model* model(size_t index) const { return entries[index].model.get(); }
+    size_t ramUsed() const { return ramBytes; }
+    size_t vramUsed() const { return vramBytes; }
+    size_t residentCount() const { return resident; }
+    unsigned loadingCount() const { return inFlight; }
+    // update() count when the model was last wanted, 0 if never; eviction goes lowest first
+    uint64_t lastWanted(size_t index) const { return entries[index].lastWanted; }
+private:
+    struct Entry {
+        std::string path;
+        glm::mat4 transform;
+        glm::vec3 center;    // world bounding sphere
+        float radius;
+        std::unique_ptr<Model> model;          // on the GPU
+        std::shared_ptr<const ModelData> data; // CPU copy, kept for re-uploads while RAM allows
+        size_t ramBytes{};
+        size_t meshBytes{};                    // GL buffers once uploaded
+        std::vector<std::pair<std::string, size_t>> textures; // file, estimated GL size with mips
+        uint64_t lastWanted{};                 // frame
+        float priority{};
+        bool loading = false;
+        bool failed = false;
+    };
+    // a read handed back by an I/O thread
+    struct Loaded {
+        size_t index;
+        std::shared_ptr<const ModelData> data; // null when the read failed
+        size_t ramBytes, meshBytes;
+        std::vector<std::pair<std::string, size_t>> textures;
+    };
+    // a texture file counts against the VRAM budget once, however many uploaded models use it
+    struct TextureUse {
+        size_t bytes;
+        unsigned users;
+    };
+    enum class Pool { Ram, Vram };
+
+    StreamingConfig config;
+    ModelConfig modelConfig;
+    std::vector<Entry> entries;
+    BoxSet bounds;                 // world boxes of the entries, in the same order
+    std::vector<uint32_t> visible; // in the frustum at the last update
+    std::vector<uint32_t> wanted;  // scratch of update(), by priority
+    std::vector<uint32_t> victims; // scratch of makeRoom()
+    std::unordered_map<std::string, TextureUse> textureUses;
+    size_t ramBytes{}, vramBytes{}, resident{};
+    unsigned inFlight{};
+    size_t readBytes{}, readCount{}; // every read so far, for the size of the next one
+    uint64_t frame{};
+    glm::vec3 lastPosition{0.0f}, velocity{0.0f};
+
+    std::mutex mutex;
+    std::vector<Loaded> finished;
+    // last member: joined first on destruction, while what its tasks touch is still alive
+    ThreadPool ioPool;
+
+    void startLoad(uint32_t index);
+    void collectLoads();
+    void upload(Entry& entry);
+    void releaseModel(Entry& entry);
+    void releaseData(Entry& entry);
+    // what uploading the entry would add to vramBytes
+    size_t uploadBytes(const Entry& entry) const;
+    // what dropping the entry from the pool would give back
+    size_t poolBytes(const Entry& entry, Pool pool) const;
+    // evict least recently wanted entries until bytes more fit the pool's budget; entries wanted
+    // this frame only go for a more important one, and only when that makes enough room
+    bool makeRoom(Pool pool, size_t bytes, float priority);
+};
+
+ModelStreamer::ModelStreamer(StreamingConfig config, ModelConfig modelConfig)
+    : config(config), modelConfig(modelConfig), ioPool(config.ioThreads) {
+    // decoding must not happen on the GL thread, and the geometry copy lives in the ModelData
+    this->modelConfig.asyncTextures = true;
+    this->modelConfig.residency = Residency::Discard;
+}
+
+ModelStreamer::~ModelStreamer() {
+    if (glfwGetCurrentContext()) {
+        for (auto& entry : entries) {
+            if (entry.model) {
+                entry.model->releaseBuffers();
+            }
+        }
+    }
+}
+
+size_t ModelStreamer::add(const std::string& path, const glm::mat4& transform, const glm::vec3& boundsCenter, const glm::vec3& boundsExtent) {
+    bounds.push(boundsCenter, boundsExtent, transform);
+    size_t index = entries.size();
+    auto& entry = entries.emplace_back();
+    entry.path = path;
+    entry.transform = transform;
+    entry.center = glm::vec3(bounds.centerX[index], bounds.centerY[index], bounds.centerZ[index]);
+    entry.radius = glm::length(glm::vec3(bounds.extentX[index], bounds.extentY[index], bounds.extentZ[index]));
+    return index;
+}
+
+void ModelStreamer::update(const Camera& camera, float deltaTime) {
+    frame ++;
+    // smoothed, so one long frame does not throw the prediction off
+    if (frame > 1 && deltaTime > 0.0f) {
+        velocity = glm::mix(velocity, (camera.position - lastPosition) / deltaTime, 0.5f);
+    }
+    lastPosition = camera.position;
+    collectLoads();
+
+    Camera ahead = camera;
+    ahead.position += velocity * config.lookAhead;
+    for (auto& entry : entries) {
+        entry.priority = std::max(camera.screenFraction(entry.center, entry.radius), ahead.screenFraction(entry.center, entry.radius));
+    }
+    cullBoxes(bounds, camera.frustum(), visible);
+    for (auto i : visible) {
+        entries[i].priority *= 2.0f;
+    }
+    wanted.clear();
+    for (uint32_t i{}; i < entries.size(); i ++) {
+        if (entries[i].priority >= config.minScreenFraction) {
+            entries[i].lastWanted = frame;
+            wanted.push_back(i);
+        }
+    }
+    std::sort(wanted.begin(), wanted.end(), [this](uint32_t a, uint32_t b) { return entries[a].priority > entries[b].priority; });
+
+    size_t uploaded{};
+    for (auto i : wanted) {
+        auto& entry = entries[i];
+        if (entry.model || entry.failed) {
+            continue;
+        }
+        if (entry.data) {
+            size_t bytes = uploadBytes(entry);
+            if ((uploaded && uploaded + bytes > config.uploadBytesPerFrame) || !makeRoom(Pool::Vram, bytes, entry.priority)) {
+                continue;
+            }
+            upload(entry);
+            uploaded += bytes;
+        } else if (!entry.loading && inFlight < config.maxInFlight) {
+            // the size is only known after the read: what it took last time, else what reads take on average
+            size_t expected = entry.ramBytes ? entry.ramBytes : readCount ? readBytes / readCount : 0;
+            if (makeRoom(Pool::Ram, expected * (inFlight + 1), entry.priority)) {
+                startLoad(i);
+            }
+        }
+    }
+    // reads that came back larger than the room left
+    makeRoom(Pool::Ram, 0, 0.0f);
+}
+
+void ModelStreamer::Draw(Shader& shader, const Camera& camera) {
+    for (auto i : visible) {
+        if (entries[i].model) {
+            entries[i].model->Draw(shader, camera, entries[i].transform);
+        }
+    }
+}
+
+void ModelStreamer::startLoad(uint32_t index) {
+    auto& entry = entries[index];
+    entry.loading = true;
+    inFlight ++;
+    ioPool.submit([this, index, path = entry.path] {
+        auto data = std::make_shared<ModelData>();
+        Loaded loaded{index, nullptr, 0, 0, {}};
+        if (Model::readData(path, modelConfig, *data)) {
+            for (auto& mesh : data->meshes) {
+                loaded.ramBytes += mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(unsigned);
+                // as Mesh::setupMesh lays the buffers out
+                size_t vertexSize = modelConfig.packedVertices ? sizeof(PackedVertex) : sizeof(Vertex);
+                size_t indexSize = mesh.vertices.size() <= 65536 ? sizeof(uint16_t) : sizeof(unsigned);
+                loaded.meshBytes += mesh.vertices.size() * vertexSize + mesh.indices.size() * indexSize;
+                for (auto& ref : mesh.textures) {
+                    std::string fileName = path.substr(0, path.find_last_of('/')) + "/" + ref.path;
+                    if (std::any_of(loaded.textures.begin(), loaded.textures.end(), [&](const auto& t) { return t.first == fileName; })) {
+                        continue;
+                    }
+                    // hashing here leaves the GL thread's TextureCache lookup a memoized hit
+                    TextureCache::global().fileKey(fileName);
+                    int width{}, height{}, channels{};
+                    size_t bytes{};
+                    if (stbi_info(fileName.c_str(), &width, &height, &channels)) {
+                        bytes = size_t(width) * height * channels * 4 / 3;
+                    }
+                    loaded.textures.emplace_back(fileName, bytes);
+                }
+            }
+            loaded.data = std::move(data);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.push_back(std::move(loaded));
+    });
+}
+
+void ModelStreamer::collectLoads() {
+    std::vector<Loaded> batch;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batch.swap(finished);
+    }
+    for (auto& loaded : batch) {
+        auto& entry = entries[loaded.index];
+        entry.loading = false;
+        inFlight --;
+        if (!loaded.data) {
+            std::cerr << "ERROR::MODEL_STREAMER: failed to read " << entry.path << '\n';
+            entry.failed = true;
+            continue;
+        }
+        entry.data = std::move(loaded.data);
+        entry.ramBytes = loaded.ramBytes;
+        entry.meshBytes = loaded.meshBytes;
+        entry.textures = std::move(loaded.textures);
+        ramBytes += entry.ramBytes;
+        readBytes += entry.ramBytes;
+        readCount ++;
+    }
+}
+
+void ModelStreamer::upload(Entry& entry) {
+    vramBytes += uploadBytes(entry);
+    for (auto& [fileName, bytes] : entry.textures) {
+        auto& use = textureUses[fileName];
+        if (use.users ++ == 0) {
+            use.bytes = bytes;
+        }
+    }
+    entry.model = std::make_unique<Model>(*entry.data, false, modelConfig);
+    resident ++;
+}
+
+void ModelStreamer::releaseModel(Entry& entry) {
+    entry.model->releaseBuffers();
+    entry.model.reset();
+    resident --;
+    vramBytes -= entry.meshBytes;
+    for (auto& [fileName, bytes] : entry.textures) {
+        auto found = textureUses.find(fileName);
+        if (-- found->second.users == 0) {
+            vramBytes -= found->second.bytes;
+            textureUses.erase(found);
+        }
+    }
+}
+
+void ModelStreamer::releaseData(Entry& entry) {
+    entry.data.reset();
+    ramBytes -= entry.ramBytes;
+}
+
+size_t ModelStreamer::uploadBytes(const Entry& entry) const {
+    size_t bytes = entry.meshBytes;
+    for (auto& [fileName, textureBytes] : entry.textures) {
+        if (!textureUses.count(fileName)) {
+            bytes += textureBytes;
+        }
+    }
+    return bytes;
+}
+
+size_t ModelStreamer::poolBytes(const Entry& entry, Pool pool) const {
+    if (pool == Pool::Ram) {
+        return entry.ramBytes;
+    }
+    size_t bytes = entry.meshBytes;
+    for (auto& [fileName, textureBytes] : entry.textures) {
+        if (textureUses.at(fileName).users == 1) {
+            bytes += textureUses.at(fileName).bytes;
+        }
+    }
+    return bytes;
+}
+
+bool ModelStreamer::makeRoom(Pool pool, size_t bytes, float priority) {
+    size_t used = pool == Pool::Ram ? ramBytes : vramBytes;
+    size_t budget = pool == Pool::Ram ? config.ramBudget : config.vramBudget;
+    if (used + bytes <= budget) {
+        return true;
+    }
+
+    victims.clear();
+    for (uint32_t i{}; i < entries.size(); i ++) {
+        auto& entry = entries[i];
+        bool held = pool == Pool::Ram ? entry.data != nullptr : entry.model != nullptr;
+        // a CPU copy of an uploaded model is only there for a later re-upload, it can always go
+        bool expendable = pool == Pool::Ram && entry.model;
+        if (held && (entry.lastWanted < frame || entry.priority < priority || expendable)) {
+            victims.push_back(i);
+        }
+    }
+    auto key = [this](uint32_t i) { return std::make_pair(entries[i].lastWanted, entries[i].priority); };
+    std::sort(victims.begin(), victims.end(), [&](uint32_t a, uint32_t b) { return key(a) < key(b); });
+
+    size_t freed{}, count{};
+    while (count < victims.size() && used - freed + bytes > budget) {
+        freed += poolBytes(entries[victims[count]], pool);
+        count ++;
+    }
+    bool enough = used - freed + bytes <= budget;
+    for (size_t v{}; v < count; v ++) {
+        auto& entry = entries[victims[v]];
+        // short of room, only what nobody needs right now is dropped
+        if (!enough && entry.lastWanted == frame && !(pool == Pool::Ram && entry.model)) {
+            continue;
+        }
+        if (pool == Pool::Ram) {
+            releaseData(entry);
+        } else {
+            releaseModel(entry);
+        }
+    }
+    return enough;
+}
+
+#endif // MODEL_STREAMER_H
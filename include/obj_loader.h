@@ -0,0 +1,475 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "mapped_file.h"
+#include "mesh.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+// fast OBJ path for Model: parses the mapped file in place and emits MeshData without building an aiScene
+// supports v/vt/vn/f/o/g/usemtl/mtllib (Kd, Ka, Ks, map_Kd, map_Ks); other statements are skipped
+// output matches Assimp's OBJ importer with aiProcess_Triangulate | aiProcess_FlipUVs:
+// one vertex per polygon corner, polygons fan-triangulated, meshes split on o, g and material changes
+// the object hierarchy is not kept, every mesh hangs under the root node
+// large files are split at line boundaries and parsed on the worker pool, then stitched back in file order
+
+// chunks smaller than this are not worth a task
+constexpr size_t OBJ_MIN_CHUNK_SIZE = size_t(1) << 20;
+// negative OBJ indices are relative to the chunk being parsed until the chunk's base is known
+constexpr int64_t OBJ_RELATIVE_INDEX = INT64_MIN / 2;
+
+// o, g, usemtl and mtllib statements, the ones that may start a new mesh or change the current material
+enum class ObjSwitchType {
+    Material,
+    Group,
+    Object,
+    Library
+};
+
+struct ObjSwitch {
+    size_t face; // first face after the statement
+    ObjSwitchType type;
+    std::string name;
+};
+
+// face corner, indices are 0-based into the file's attribute pools, -1 when absent
+// while a chunk is parsed, negative OBJ indices are stored as OBJ_RELATIVE_INDEX + chunk-local index
+struct ObjCorner {
+    int64_t v, t, n;
+};
+
+// everything parsed out of one range of the file
+struct ObjChunk {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texcoords;
+    std::vector<glm::vec3> normals;
+    std::vector<ObjCorner> corners;  // polygon corners, back to back
+    std::vector<uint32_t> faceSizes; // corner count of each polygon
+    std::vector<ObjSwitch> switches;
+};
+
+// parse an OBJ and its material libraries into MeshData in Assimp's mesh order, false if the file cannot be read
+bool loadObjFast(const std::string& path, std::vector<MeshData>& meshes, bool parallel = true);
+
+// parse [begin, end) which must start at a line boundary
+void parseObjChunk(const char* begin, const char* end, ObjChunk& chunk);
+
+// concatenate chunks in file order and resolve their relative indices
+ObjChunk mergeObjChunks(std::vector<ObjChunk>& chunks);
+
+const char* objSkipSpace(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p ++;
+    }
+    return p;
+}
+
+const char* objParseFloat(const char* p, const char* end, float& value) {
+    p = objSkipSpace(p, end);
+    if (p < end && *p == '+') { // from_chars rejects an explicit plus sign
+        p ++;
+    }
+    auto result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) {
+        value = 0.0f;
+    }
+    return result.ptr;
+}
+
+const char* objParseInt(const char* p, const char* end, int64_t& value) {
+    if (p < end && *p == '+') {
+        p ++;
+    }
+    auto result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) {
+        value = 0;
+    }
+    return result.ptr;
+}
+
+// OBJ indices are 1-based, negative ones count back from the current end of the pool
+// the pool here is the chunk's, so those are left relative for mergeObjChunks
+int64_t objResolveIndex(int64_t index, size_t count) {
+    if (index > 0) {
+        return index - 1;
+    } else if (index < 0) {
+        return OBJ_RELATIVE_INDEX + static_cast<int64_t>(count) + index;
+    }
+    return -1;
+}
+
+int64_t objRebaseIndex(int64_t index, size_t base) {
+    return index < -1 ? index - OBJ_RELATIVE_INDEX + static_cast<int64_t>(base) : index;
+}
+
+std::string_view objRestOfLine(const char* p, const char* end) {
+    p = objSkipSpace(p, end);
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) {
+        end --;
+    }
+    return std::string_view(p, end - p);
+}
+
+void parseObjChunk(const char* begin, const char* end, ObjChunk& chunk) {
+    std::vector<ObjCorner> polygon;
+    const char* line = begin;
+    while (line < end) {
+        auto newline = static_cast<const char*>(std::memchr(line, '\n', end - line));
+        const char* lineEnd = newline ? newline : end;
+        const char* p = objSkipSpace(line, lineEnd);
+        line = lineEnd + 1;
+        if (p >= lineEnd || *p == '#') {
+            continue;
+        }
+
+        if (p[0] == 'v' && p + 1 < lineEnd && (p[1] == ' ' || p[1] == '\t')) {
+            glm::vec3 pos;
+            p = objParseFloat(p + 1, lineEnd, pos.x);
+            p = objParseFloat(p, lineEnd, pos.y);
+            objParseFloat(p, lineEnd, pos.z);
+            chunk.positions.push_back(pos);
+        } else if (p[0] == 'v' && p + 2 < lineEnd && p[1] == 't' && (p[2] == ' ' || p[2] == '\t')) {
+            glm::vec2 uv;
+            p = objParseFloat(p + 2, lineEnd, uv.x);
+            objParseFloat(p, lineEnd, uv.y);
+            uv.y = 1.0f - uv.y; // aiProcess_FlipUVs
+            chunk.texcoords.push_back(uv);
+        } else if (p[0] == 'v' && p + 2 < lineEnd && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t')) {
+            glm::vec3 normal;
+            p = objParseFloat(p + 2, lineEnd, normal.x);
+            p = objParseFloat(p, lineEnd, normal.y);
+            objParseFloat(p, lineEnd, normal.z);
+            chunk.normals.push_back(normal);
+        } else if (p[0] == 'f' && p + 1 < lineEnd && (p[1] == ' ' || p[1] == '\t')) {
+            polygon.clear();
+            p ++;
+            while (true) {
+                p = objSkipSpace(p, lineEnd);
+                if (p >= lineEnd || *p == '\r') {
+                    break;
+                }
+                int64_t v{}, t{}, n{};
+                p = objParseInt(p, lineEnd, v);
+                if (p < lineEnd && *p == '/') {
+                    p ++;
+                    if (p < lineEnd && *p != '/') {
+                        p = objParseInt(p, lineEnd, t);
+                    }
+                    if (p < lineEnd && *p == '/') {
+                        p = objParseInt(p + 1, lineEnd, n);
+                    }
+                }
+                // skip anything unparsable so a bad token cannot stall the loop
+                while (p < lineEnd && *p != ' ' && *p != '\t' && *p != '\r') {
+                    p ++;
+                }
+                polygon.push_back({
+                    objResolveIndex(v, chunk.positions.size()),
+                    objResolveIndex(t, chunk.texcoords.size()),
+                    objResolveIndex(n, chunk.normals.size())
+                });
+            }
+            // points and lines are not drawn by Model, skip them
+            if (polygon.size() >= 3) {
+                chunk.corners.insert(chunk.corners.end(), polygon.begin(), polygon.end());
+                chunk.faceSizes.push_back(static_cast<uint32_t>(polygon.size()));
+            }
+        } else if (lineEnd - p > 7 && std::memcmp(p, "usemtl", 6) == 0 && (p[6] == ' ' || p[6] == '\t')) {
+            chunk.switches.push_back({chunk.faceSizes.size(), ObjSwitchType::Material, std::string(objRestOfLine(p + 6, lineEnd))});
+        } else if ((p[0] == 'g' || p[0] == 'o') && p + 1 < lineEnd && (p[1] == ' ' || p[1] == '\t')) {
+            // groups are named by the whole line, objects by its first token
+            auto name = objRestOfLine(p + 1, lineEnd);
+            if (p[0] == 'o') {
+                name = name.substr(0, name.find_first_of(" \t"));
+            }
+            chunk.switches.push_back({chunk.faceSizes.size(), p[0] == 'g' ? ObjSwitchType::Group : ObjSwitchType::Object, std::string(name)});
+        } else if (lineEnd - p > 7 && std::memcmp(p, "mtllib", 6) == 0 && (p[6] == ' ' || p[6] == '\t')) {
+            chunk.switches.push_back({chunk.faceSizes.size(), ObjSwitchType::Library, std::string(objRestOfLine(p + 6, lineEnd))});
+        }
+    }
+}
+
+// read newmtl blocks from a .mtl file, defaults follow Assimp's ObjFile::Material
+// returns the last newmtl name, which Assimp leaves as the current material, empty if there is none
+std::string loadObjMaterials(const std::string& path, std::unordered_map<std::string, MeshData>& materials) {
+    MappedFile file(path);
+    if (!file.isOpen()) {
+        return {};
+    }
+    auto begin = reinterpret_cast<const char*>(file.data());
+    auto end = begin + file.size();
+
+    MeshData* current = nullptr;
+    std::string last;
+    auto readColor = [](const char* p, const char* lineEnd) {
+        glm::vec3 color;
+        p = objParseFloat(p, lineEnd, color.r);
+        p = objParseFloat(p, lineEnd, color.g);
+        objParseFloat(p, lineEnd, color.b);
+        return color;
+    };
+    // map statements may carry options (-s 1 1 1 file.png), the file name is the last token
+    auto readMap = [](const char* p, const char* lineEnd) {
+        auto rest = objRestOfLine(p, lineEnd);
+        auto space = rest.find_last_of(" \t");
+        return std::string(space == std::string_view::npos ? rest : rest.substr(space + 1));
+    };
+
+    const char* line = begin;
+    while (line < end) {
+        auto newline = static_cast<const char*>(std::memchr(line, '\n', end - line));
+        const char* lineEnd = newline ? newline : end;
+        const char* p = objSkipSpace(line, lineEnd);
+        line = lineEnd + 1;
+        std::string_view rest(p, lineEnd - p);
+
+        if (rest.starts_with("newmtl ") || rest.starts_with("newmtl\t")) {
+            last = objRestOfLine(p + 6, lineEnd);
+            current = &materials[last];
+            current->material = {glm::vec3(0.6f), glm::vec3(0.0f), glm::vec3(0.0f)};
+        } else if (!current) {
+            continue;
+        } else if (rest.starts_with("Kd ")) {
+            current->material.mDiffuse = readColor(p + 2, lineEnd);
+        } else if (rest.starts_with("Ka ")) {
+            current->material.mAmbient = readColor(p + 2, lineEnd);
+        } else if (rest.starts_with("Ks ")) {
+            current->material.mSpecular = readColor(p + 2, lineEnd);
+        } else if (rest.starts_with("map_Kd ")) {
+            current->textures.push_back({"texture_diffuse", readMap(p + 6, lineEnd)});
+        } else if (rest.starts_with("map_Ks ")) {
+            current->textures.push_back({"texture_specular", readMap(p + 6, lineEnd)});
+        }
+    }
+    return last;
+}
+
+ObjChunk mergeObjChunks(std::vector<ObjChunk>& chunks) {
+    // prefix sums give every chunk its offset in the merged pools
+    size_t count = chunks.size();
+    std::vector<size_t> positionBase(count + 1), texcoordBase(count + 1), normalBase(count + 1), cornerBase(count + 1), faceBase(count + 1);
+    for (size_t i{}; i < count; i ++) {
+        positionBase[i + 1] = positionBase[i] + chunks[i].positions.size();
+        texcoordBase[i + 1] = texcoordBase[i] + chunks[i].texcoords.size();
+        normalBase[i + 1] = normalBase[i] + chunks[i].normals.size();
+        cornerBase[i + 1] = cornerBase[i] + chunks[i].corners.size();
+        faceBase[i + 1] = faceBase[i] + chunks[i].faceSizes.size();
+    }
+
+    ObjChunk merged;
+    if (count == 1) {
+        merged = std::move(chunks[0]);
+    } else {
+        merged.positions.resize(positionBase[count]);
+        merged.texcoords.resize(texcoordBase[count]);
+        merged.normals.resize(normalBase[count]);
+        merged.corners.resize(cornerBase[count]);
+        merged.faceSizes.resize(faceBase[count]);
+    }
+
+    ThreadPool::global().parallelFor(count, [&](size_t i) {
+        auto& chunk = count == 1 ? merged : chunks[i];
+        if (count > 1) {
+            std::copy(chunk.positions.begin(), chunk.positions.end(), merged.positions.begin() + positionBase[i]);
+            std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), merged.texcoords.begin() + texcoordBase[i]);
+            std::copy(chunk.normals.begin(), chunk.normals.end(), merged.normals.begin() + normalBase[i]);
+            std::copy(chunk.faceSizes.begin(), chunk.faceSizes.end(), merged.faceSizes.begin() + faceBase[i]);
+            // release as we go, so peak memory stays close to one copy of the file's data
+            std::vector<glm::vec3>().swap(chunk.positions);
+            std::vector<glm::vec2>().swap(chunk.texcoords);
+            std::vector<glm::vec3>().swap(chunk.normals);
+            std::vector<uint32_t>().swap(chunk.faceSizes);
+        }
+        auto out = merged.corners.begin() + cornerBase[i];
+        for (auto& corner : chunk.corners) {
+            *out ++ = {
+                objRebaseIndex(corner.v, positionBase[i]),
+                objRebaseIndex(corner.t, texcoordBase[i]),
+                objRebaseIndex(corner.n, normalBase[i])
+            };
+        }
+        if (count > 1) {
+            std::vector<ObjCorner>().swap(chunk.corners);
+        }
+    });
+
+    // o, g, usemtl and mtllib statements are few, stitch them serially
+    if (count > 1) {
+        for (size_t i{}; i < count; i ++) {
+            for (auto& sw : chunks[i].switches) {
+                merged.switches.push_back({faceBase[i] + sw.face, sw.type, std::move(sw.name)});
+            }
+        }
+    }
+    return merged;
+}
+
+bool loadObjFast(const std::string& path, std::vector<MeshData>& meshes, bool parallel) {
+    TRACE_SCOPE("loadObjFast");
+    MappedFile file(path);
+    if (!file.isOpen()) {
+        return false;
+    }
+    auto begin = reinterpret_cast<const char*>(file.data());
+    auto end = begin + file.size();
+
+    // split at newline boundaries, one chunk per worker plus the calling thread
+    auto& pool = ThreadPool::global();
+    size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+    size_t chunkCount = parallel ? std::clamp<size_t>(file.size() / OBJ_MIN_CHUNK_SIZE, 1, std::min<size_t>(cores, pool.size() + 1)) : 1;
+    std::vector<const char*> bounds(chunkCount + 1, end);
+    bounds[0] = begin;
+    for (size_t i = 1; i < chunkCount; i ++) {
+        const char* p = std::max(begin + file.size() * i / chunkCount, bounds[i - 1]);
+        auto newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        bounds[i] = newline ? newline + 1 : end;
+    }
+
+    std::vector<ObjChunk> chunks(chunkCount);
+    pool.parallelFor(chunkCount, [&](size_t i) {
+        TRACE_SCOPE("parseObjChunk");
+        parseObjChunk(bounds[i], bounds[i + 1], chunks[i]);
+    });
+    ObjChunk chunk = mergeObjChunks(chunks);
+
+    // first corner of every face
+    std::vector<size_t> faceStarts(chunk.faceSizes.size() + 1);
+    for (size_t f{}; f < chunk.faceSizes.size(); f ++) {
+        faceStarts[f + 1] = faceStarts[f] + chunk.faceSizes[f];
+    }
+
+    // cut the faces into meshes the way Assimp's ObjFileParser does: a new group or object starts a mesh,
+    // a material change starts one only once the current mesh has faces, and o naming a known object resumes it
+    // material libraries are read where mtllib appears, since they change the current material
+    // every mesh ends up a contiguous face range
+    struct ObjMeshRange {
+        size_t object;
+        std::string material;
+        size_t first, last;
+    };
+    std::string directory = path.substr(0, path.find_last_of('/'));
+    std::unordered_map<std::string, MeshData> materials;
+    constexpr size_t none = SIZE_MAX;
+    std::vector<ObjMeshRange> ranges;
+    std::vector<std::string> objects;
+    size_t object = none, current = none, assigned = 0;
+    std::string material = "DefaultMaterial", group;
+    auto startMesh = [&] {
+        ranges.push_back({object, {}, assigned, assigned});
+        current = ranges.size() - 1;
+    };
+    auto startObject = [&](const std::string& name) {
+        objects.push_back(name);
+        object = objects.size() - 1;
+        startMesh();
+        ranges[current].material = material;
+    };
+    auto assignFaces = [&](size_t face) {
+        if (face == assigned) {
+            return;
+        }
+        if (object == none) {
+            startObject("defaultobject");
+        }
+        assigned = ranges[current].last = face;
+    };
+    for (auto& sw : chunk.switches) {
+        assignFaces(sw.face);
+        if (sw.type == ObjSwitchType::Group) {
+            if (sw.name != group) {
+                startObject(sw.name);
+                group = sw.name;
+            }
+        } else if (sw.type == ObjSwitchType::Object) {
+            if (sw.name.empty()) {
+                continue;
+            }
+            auto found = std::find(objects.begin(), objects.end(), sw.name);
+            if (found != objects.end()) {
+                object = static_cast<size_t>(found - objects.begin());
+            } else {
+                startObject(sw.name);
+            }
+        } else if (sw.type == ObjSwitchType::Library) {
+            auto last = loadObjMaterials(directory + "/" + sw.name, materials);
+            if (!last.empty()) {
+                material = last;
+            }
+        } else if (!sw.name.empty() && sw.name != material) {
+            material = sw.name;
+            if (current == none) {
+                continue;
+            }
+            auto& range = ranges[current];
+            if (range.first != range.last) {
+                startMesh();
+            }
+            ranges[current].material = material;
+        }
+    }
+    assignFaces(chunk.faceSizes.size());
+
+    // Assimp emits meshes object by object
+    std::erase_if(ranges, [](const ObjMeshRange& range) { return range.first == range.last; });
+    std::stable_sort(ranges.begin(), ranges.end(), [](const ObjMeshRange& a, const ObjMeshRange& b) { return a.object < b.object; });
+
+    size_t firstMesh = meshes.size();
+    meshes.resize(firstMesh + ranges.size());
+    for (size_t m{}; m < ranges.size(); m ++) {
+        auto& range = ranges[m];
+        auto& mesh = meshes[firstMesh + m];
+        auto found = materials.find(range.material);
+        if (found != materials.end()) {
+            mesh.material = found->second.material;
+            mesh.textures = found->second.textures;
+        } else {
+            mesh.material = {glm::vec3(0.6f), glm::vec3(0.0f), glm::vec3(0.0f)};
+        }
+    }
+
+    // every mesh is filled by one task, sized up front
+    pool.parallelFor(ranges.size(), [&](size_t m) {
+        auto& range = ranges[m];
+        auto& mesh = meshes[firstMesh + m];
+        size_t corners = faceStarts[range.last] - faceStarts[range.first];
+        mesh.vertices.reserve(corners);
+        mesh.indices.reserve(3 * corners - 6 * (range.last - range.first));
+        for (size_t f = range.first; f < range.last; f ++) {
+            auto base = static_cast<unsigned>(mesh.vertices.size());
+            for (size_t c = faceStarts[f]; c < faceStarts[f + 1]; c ++) {
+                auto& corner = chunk.corners[c];
+                Vertex vertex{};
+                if (corner.v >= 0 && corner.v < static_cast<int64_t>(chunk.positions.size())) {
+                    vertex.Position = chunk.positions[corner.v];
+                }
+                if (corner.n >= 0 && corner.n < static_cast<int64_t>(chunk.normals.size())) {
+                    vertex.Normal = chunk.normals[corner.n];
+                }
+                if (corner.t >= 0 && corner.t < static_cast<int64_t>(chunk.texcoords.size())) {
+                    vertex.TexCoord = chunk.texcoords[corner.t];
+                }
+                mesh.vertices.push_back(vertex);
+            }
+            // fan triangulation, same as aiProcess_Triangulate for convex faces
+            for (unsigned i = 2; i < chunk.faceSizes[f]; i ++) {
+                mesh.indices.push_back(base);
+                mesh.indices.push_back(base + i - 1);
+                mesh.indices.push_back(base + i);
+            }
+        }
+    });
+    return true;
+}
+
+#endif // OBJ_LOADER_H
@@ -0,0 +1,363 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "culling.h"
+#include "mesh.h"
+#include "simd.h"
+#include "thread_pool.h"
+
+constexpr int OCCLUSION_WIDTH = 320;
+constexpr int OCCLUSION_HEIGHT = 192;
+// tiles are the unit of work per thread; the width is a multiple of 8 so SIMD rows never straddle two
+constexpr int OCCLUSION_TILE_WIDTH = 32;
+constexpr int OCCLUSION_TILE_HEIGHT = 16;
+
+// low-resolution CPU depth buffer for occlusion culling without GPU readback: occluder triangles
+// are binned into screen tiles, the tiles rasterized in parallel SIMD_WIDTH pixels at a time, and
+// bounding boxes tested against the result before draw submission
+// per frame: clear(), addOccluder() for the big nearby meshes, rasterize(), then boxVisible()
+class OcclusionBuffer {
+public:
+    // sizes are rounded up to whole tiles
+    explicit OcclusionBuffer(int width = OCCLUSION_WIDTH, int height = OCCLUSION_HEIGHT);
+
+    // far depth everywhere; occluders and tests use this matrix (projection * view)
+    void clear(const glm::mat4& viewProjection);
+    // bin the triangles of an occluder under a model matrix, front faces counter-clockwise
+    void addOccluder(const Vertex* vertices, size_t vertexCount, const unsigned* indices, size_t indexCount, const glm::mat4& model);
+    // rasterize what was binned since the last call, needed before testing
+    void rasterize();
+
+    // true when some part of the world-space box may be in front of the occluders
+    bool boxVisible(const glm::vec3& center, const glm::vec3& extent) const;
+    // drop the occluded boxes from a visible list (e.g. from cullBoxes), keeping the order
+    void filterVisible(const BoxSet& boxes, std::vector<uint32_t>& visible) const;
+    // clip-space w of a world point, to sort occluder candidates front to back
+    float viewDepth(const glm::vec3& point) const;
+
+    int width() const { return bufferWidth; }
+    int height() const { return bufferHeight; }
+    // rows bottom to top, window depth in [0, 1]
+    const float* depth() const { return depthBuffer.data(); }
+    // front-facing on-screen triangles rasterized since clear()
+    size_t rasterizedTriangles() const { return triangleTotal; }
+private:
+    // edge functions E(x, y) = a x + b y + c, inside where all three are >= 0, and the depth plane
+    struct ScreenTriangle {
+        float edgeA[3], edgeB[3], edgeC[3];
+        float depthA, depthB, depthC;
+        int minX, minY, maxX, maxY;
+    };
+
+    int bufferWidth, bufferHeight, tilesX, tilesY;
+    glm::mat4 viewProjection{1.0f};
+    std::vector<float> depthBuffer;
+    std::vector<float> tileMaxDepth; // farthest depth per tile, rejects most box tests without a pixel loop
+    std::vector<ScreenTriangle> triangles;
+    std::vector<std::vector<uint32_t>> bins;
+    std::vector<glm::vec4> clipPositions; // scratch of addOccluder
+    size_t triangleTotal = 0;
+
+    void addTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+    void rasterizeTile(int tile);
+    // window-space rectangle with the box's nearest depth against the tiles, then the pixels
+    bool rectVisible(float minX, float minY, float maxX, float maxY, float nearest) const;
+};
+
+OcclusionBuffer::OcclusionBuffer(int width, int height) {
+    tilesX = (std::max(width, 1) + OCCLUSION_TILE_WIDTH - 1) / OCCLUSION_TILE_WIDTH;
+    tilesY = (std::max(height, 1) + OCCLUSION_TILE_HEIGHT - 1) / OCCLUSION_TILE_HEIGHT;
+    bufferWidth = tilesX * OCCLUSION_TILE_WIDTH;
+    bufferHeight = tilesY * OCCLUSION_TILE_HEIGHT;
+    depthBuffer.assign(size_t(bufferWidth) * bufferHeight, 1.0f);
+    tileMaxDepth.assign(size_t(tilesX) * tilesY, 1.0f);
+    bins.resize(size_t(tilesX) * tilesY);
+}
+
+void OcclusionBuffer::clear(const glm::mat4& viewProjection) {
+    this->viewProjection = viewProjection;
+    std::fill(depthBuffer.begin(), depthBuffer.end(), 1.0f);
+    std::fill(tileMaxDepth.begin(), tileMaxDepth.end(), 1.0f);
+    for (auto& bin : bins) {
+        bin.clear();
+    }
+    triangles.clear();
+    triangleTotal = 0;
+}
+
+void OcclusionBuffer::addOccluder(const Vertex* vertices, size_t vertexCount, const unsigned* indices, size_t indexCount, const glm::mat4& model) {
+    glm::mat4 matrix = viewProjection * model;
+    clipPositions.resize(vertexCount);
+    for (size_t i{}; i < vertexCount; i ++) {
+        clipPositions[i] = matrix * glm::vec4(vertices[i].Position, 1.0f);
+    }
+
+    for (size_t t{}; t + 2 < indexCount; t += 3) {
+        glm::vec4 corner[3] = {clipPositions[indices[t]], clipPositions[indices[t + 1]], clipPositions[indices[t + 2]]};
+        // trivially outside one of the side or far planes
+        bool outside = false;
+        for (int axis{}; axis < 3 && !outside; axis ++) {
+            outside = (corner[0][axis] > corner[0].w && corner[1][axis] > corner[1].w && corner[2][axis] > corner[2].w)
+                || (axis < 2 && corner[0][axis] < -corner[0].w && corner[1][axis] < -corner[1].w && corner[2][axis] < -corner[2].w);
+        }
+        if (outside) {
+            continue;
+        }
+
+        // clip against the near plane (z >= -w), which leaves a triangle or a quad
+        float distance[3];
+        int behind{};
+        for (int k{}; k < 3; k ++) {
+            distance[k] = corner[k].z + corner[k].w;
+            behind += distance[k] < 0.0f;
+        }
+        if (behind == 0) {
+            addTriangle(corner[0], corner[1], corner[2]);
+            continue;
+        }
+        if (behind == 3) {
+            continue;
+        }
+        glm::vec4 polygon[4];
+        int count{};
+        for (int k{}; k < 3; k ++) {
+            int next = (k + 1) % 3;
+            if (distance[k] >= 0.0f) {
+                polygon[count ++] = corner[k];
+            }
+            if ((distance[k] >= 0.0f) != (distance[next] >= 0.0f)) {
+                float s = distance[k] / (distance[k] - distance[next]);
+                polygon[count ++] = corner[k] + (corner[next] - corner[k]) * s;
+            }
+        }
+        for (int k = 1; k + 1 < count; k ++) {
+            addTriangle(polygon[0], polygon[k], polygon[k + 1]);
+        }
+    }
+}
+
+void OcclusionBuffer::addTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+    // window coordinates, y up like GL
+    glm::vec3 v[3];
+    const glm::vec4* clip[3] = {&a, &b, &c};
+    for (int k{}; k < 3; k ++) {
+        float w = std::max(clip[k]->w, 1e-6f);
+        v[k] = glm::vec3((clip[k]->x / w * 0.5f + 0.5f) * bufferWidth, (clip[k]->y / w * 0.5f + 0.5f) * bufferHeight,
+            clip[k]->z / w * 0.5f + 0.5f);
+    }
+    float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+    if (!(area > 0.0f)) {
+        return; // back-facing, degenerate or NaN
+    }
+
+    // clamp before converting, vertices close to the eye land far outside the buffer
+    auto pixel = [](float coordinate, int size) { return static_cast<int>(std::floor(std::clamp(coordinate, -1.0f, float(size)))); };
+    ScreenTriangle triangle;
+    triangle.minX = std::max(0, pixel(std::min({v[0].x, v[1].x, v[2].x}), bufferWidth));
+    triangle.minY = std::max(0, pixel(std::min({v[0].y, v[1].y, v[2].y}), bufferHeight));
+    triangle.maxX = std::min(bufferWidth - 1, pixel(std::max({v[0].x, v[1].x, v[2].x}), bufferWidth));
+    triangle.maxY = std::min(bufferHeight - 1, pixel(std::max({v[0].y, v[1].y, v[2].y}), bufferHeight));
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+        return;
+    }
+
+    // edge k runs from v[k] to v[k + 1], the inside of a counter-clockwise triangle is on its left
+    for (int k{}; k < 3; k ++) {
+        const glm::vec3& from = v[k];
+        const glm::vec3& to = v[(k + 1) % 3];
+        triangle.edgeA[k] = from.y - to.y;
+        triangle.edgeB[k] = to.x - from.x;
+        triangle.edgeC[k] = -(triangle.edgeA[k] * from.x + triangle.edgeB[k] * from.y);
+    }
+    // depth is affine in window space: v0 plus barycentrics of v1 (edge 2) and v2 (edge 0)
+    float dz1 = (v[1].z - v[0].z) / area, dz2 = (v[2].z - v[0].z) / area;
+    triangle.depthA = triangle.edgeA[2] * dz1 + triangle.edgeA[0] * dz2;
+    triangle.depthB = triangle.edgeB[2] * dz1 + triangle.edgeB[0] * dz2;
+    triangle.depthC = triangle.edgeC[2] * dz1 + triangle.edgeC[0] * dz2 + v[0].z;
+
+    auto index = static_cast<uint32_t>(triangles.size());
+    triangles.push_back(triangle);
+    for (int ty = triangle.minY / OCCLUSION_TILE_HEIGHT; ty <= triangle.maxY / OCCLUSION_TILE_HEIGHT; ty ++) {
+        for (int tx = triangle.minX / OCCLUSION_TILE_WIDTH; tx <= triangle.maxX / OCCLUSION_TILE_WIDTH; tx ++) {
+            bins[ty * tilesX + tx].push_back(index);
+        }
+    }
+}
+
+void OcclusionBuffer::rasterize() {
+    // every tile is written by exactly one task, so the tiles need no locking
+    ThreadPool::global().parallelFor(bins.size(), [&](size_t tile) { rasterizeTile(static_cast<int>(tile)); });
+    triangleTotal += triangles.size();
+    triangles.clear();
+    for (auto& bin : bins) {
+        bin.clear();
+    }
+}
+
+void OcclusionBuffer::rasterizeTile(int tile) {
+    if (bins[tile].empty()) {
+        return;
+    }
+    static const float laneOffset[8] = {0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f};
+    SimdFloat lanes = simdLoad(laneOffset);
+    SimdFloat zero = simdSet(0.0f);
+    int tileX = (tile % tilesX) * OCCLUSION_TILE_WIDTH, tileY = (tile / tilesX) * OCCLUSION_TILE_HEIGHT;
+
+    for (auto index : bins[tile]) {
+        const auto& triangle = triangles[index];
+        int x0 = std::max(triangle.minX, tileX), x1 = std::min(triangle.maxX, tileX + OCCLUSION_TILE_WIDTH - 1);
+        int y0 = std::max(triangle.minY, tileY), y1 = std::min(triangle.maxY, tileY + OCCLUSION_TILE_HEIGHT - 1);
+        // start on a SIMD boundary, the tile origin is one, so rows stay inside the tile
+        x0 -= (x0 - tileX) % static_cast<int>(SIMD_WIDTH);
+        for (int y = y0; y <= y1; y ++) {
+            SimdFloat py = simdSet(y + 0.5f);
+            float* row = &depthBuffer[size_t(y) * bufferWidth];
+            for (int x = x0; x <= x1; x += SIMD_WIDTH) {
+                SimdFloat px = simdSet(static_cast<float>(x)) + lanes;
+                SimdFloat inside = simdGreaterEqual(simdSet(triangle.edgeA[0]) * px + simdSet(triangle.edgeB[0]) * py + simdSet(triangle.edgeC[0]), zero)
+                    & simdGreaterEqual(simdSet(triangle.edgeA[1]) * px + simdSet(triangle.edgeB[1]) * py + simdSet(triangle.edgeC[1]), zero)
+                    & simdGreaterEqual(simdSet(triangle.edgeA[2]) * px + simdSet(triangle.edgeB[2]) * py + simdSet(triangle.edgeC[2]), zero);
+                if (!simdMask(inside)) {
+                    continue;
+                }
+                SimdFloat depth = simdSet(triangle.depthA) * px + simdSet(triangle.depthB) * py + simdSet(triangle.depthC);
+                SimdFloat old = simdLoad(row + x);
+                simdStore(row + x, simdSelect(inside, simdMin(old, depth), old));
+            }
+        }
+    }
+
+    float farthest{};
+    for (int y = tileY; y < tileY + OCCLUSION_TILE_HEIGHT; y ++) {
+        const float* row = &depthBuffer[size_t(y) * bufferWidth + tileX];
+        farthest = std::max(farthest, *std::max_element(row, row + OCCLUSION_TILE_WIDTH));
+    }
+    tileMaxDepth[tile] = farthest;
+}
+
+bool OcclusionBuffer::boxVisible(const glm::vec3& center, const glm::vec3& extent) const {
+    // window-space rectangle and nearest depth of the eight corners
+    float minX = bufferWidth, minY = bufferHeight, maxX = -1.0f, maxY = -1.0f, nearest = 1.0f;
+    for (int k{}; k < 8; k ++) {
+        glm::vec3 corner = center + extent * glm::vec3(k & 1 ? 1.0f : -1.0f, k & 2 ? 1.0f : -1.0f, k & 4 ? 1.0f : -1.0f);
+        glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+        if (clip.z < -clip.w || clip.w <= 1e-6f) {
+            return true; // crosses the near plane, cannot be judged in window space
+        }
+        float x = (clip.x / clip.w * 0.5f + 0.5f) * bufferWidth, y = (clip.y / clip.w * 0.5f + 0.5f) * bufferHeight;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::min(nearest, clip.z / clip.w * 0.5f + 0.5f);
+    }
+    return rectVisible(minX, minY, maxX, maxY, nearest);
+}
+
+bool OcclusionBuffer::rectVisible(float minX, float minY, float maxX, float maxY, float nearest) const {
+    auto pixel = [](float coordinate, int size) { return static_cast<int>(std::floor(std::clamp(coordinate, -1.0f, float(size)))); };
+    int x0 = std::max(0, pixel(minX, bufferWidth)), x1 = std::min(bufferWidth - 1, pixel(maxX, bufferWidth));
+    int y0 = std::max(0, pixel(minY, bufferHeight)), y1 = std::min(bufferHeight - 1, pixel(maxY, bufferHeight));
+    if (x0 > x1 || y0 > y1) {
+        return false;
+    }
+
+    for (int ty = y0 / OCCLUSION_TILE_HEIGHT; ty <= y1 / OCCLUSION_TILE_HEIGHT; ty ++) {
+        for (int tx = x0 / OCCLUSION_TILE_WIDTH; tx <= x1 / OCCLUSION_TILE_WIDTH; tx ++) {
+            if (nearest > tileMaxDepth[ty * tilesX + tx]) {
+                continue; // everything in this tile is in front of the box
+            }
+            int px0 = std::max(x0, tx * OCCLUSION_TILE_WIDTH), px1 = std::min(x1, (tx + 1) * OCCLUSION_TILE_WIDTH - 1);
+            int py0 = std::max(y0, ty * OCCLUSION_TILE_HEIGHT), py1 = std::min(y1, (ty + 1) * OCCLUSION_TILE_HEIGHT - 1);
+            for (int y = py0; y <= py1; y ++) {
+                const float* row = &depthBuffer[size_t(y) * bufferWidth];
+                for (int x = px0; x <= px1; x ++) {
+                    if (nearest <= row[x]) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
+void OcclusionBuffer::filterVisible(const BoxSet& boxes, std::vector<uint32_t>& visible) const {
+    // boxes are projected SIMD_WIDTH at a time: the clip-space center plus or minus each
+    // axis' contribution gives the eight corners without a matrix product per corner
+    float row[4][4];
+    for (int r{}; r < 4; r ++) {
+        for (int c{}; c < 4; c ++) {
+            row[r][c] = viewProjection[c][r];
+        }
+    }
+    alignas(32) float lane[6][8], result[5][8];
+    size_t kept{};
+    for (size_t first{}; first < visible.size(); first += SIMD_WIDTH) {
+        size_t count = std::min<size_t>(SIMD_WIDTH, visible.size() - first);
+        for (size_t l{}; l < SIMD_WIDTH; l ++) {
+            uint32_t i = visible[first + std::min(l, count - 1)];
+            lane[0][l] = boxes.centerX[i];
+            lane[1][l] = boxes.centerY[i];
+            lane[2][l] = boxes.centerZ[i];
+            lane[3][l] = boxes.extentX[i];
+            lane[4][l] = boxes.extentY[i];
+            lane[5][l] = boxes.extentZ[i];
+        }
+        SimdFloat cx = simdLoad(lane[0]), cy = simdLoad(lane[1]), cz = simdLoad(lane[2]);
+        SimdFloat ex = simdLoad(lane[3]), ey = simdLoad(lane[4]), ez = simdLoad(lane[5]);
+        SimdFloat base[4], axisX[4], axisY[4], axisZ[4];
+        for (int r{}; r < 4; r ++) {
+            base[r] = simdSet(row[r][0]) * cx + simdSet(row[r][1]) * cy + simdSet(row[r][2]) * cz + simdSet(row[r][3]);
+            axisX[r] = simdSet(row[r][0]) * ex;
+            axisY[r] = simdSet(row[r][1]) * ey;
+            axisZ[r] = simdSet(row[r][2]) * ez;
+        }
+
+        SimdFloat minX = simdSet(float(bufferWidth)), minY = simdSet(float(bufferHeight));
+        SimdFloat maxX = simdSet(-1.0f), maxY = simdSet(-1.0f), nearest = simdSet(1.0f);
+        SimdFloat crossing = simdLess(simdSet(1.0f), simdSet(0.0f));
+        SimdFloat half = simdSet(0.5f), zero = simdSet(0.0f), epsilon = simdSet(1e-6f);
+        for (int k{}; k < 8; k ++) {
+            SimdFloat clip[4];
+            for (int r{}; r < 4; r ++) {
+                clip[r] = base[r] + (k & 1 ? axisX[r] : zero - axisX[r]) + (k & 2 ? axisY[r] : zero - axisY[r]) + (k & 4 ? axisZ[r] : zero - axisZ[r]);
+            }
+            crossing = crossing | simdLess(clip[2] + clip[3], zero) | simdLess(clip[3], epsilon);
+            SimdFloat w = simdMax(clip[3], epsilon);
+            SimdFloat x = (clip[0] / w * half + half) * simdSet(float(bufferWidth));
+            SimdFloat y = (clip[1] / w * half + half) * simdSet(float(bufferHeight));
+            minX = simdMin(minX, x);
+            maxX = simdMax(maxX, x);
+            minY = simdMin(minY, y);
+            maxY = simdMax(maxY, y);
+            nearest = simdMin(nearest, clip[2] / w * half + half);
+        }
+        simdStore(result[0], minX);
+        simdStore(result[1], minY);
+        simdStore(result[2], maxX);
+        simdStore(result[3], maxY);
+        simdStore(result[4], nearest);
+        unsigned crossingMask = simdMask(crossing);
+
+        for (size_t l{}; l < count; l ++) {
+            if (crossingMask & (1u << l) || rectVisible(result[0][l], result[1][l], result[2][l], result[3][l], result[4][l])) {
+                visible[kept ++] = visible[first + l];
+            }
+        }
+    }
+    visible.resize(kept);
+}
+
+float OcclusionBuffer::viewDepth(const glm::vec3& point) const {
+    return (viewProjection * glm::vec4(point, 1.0f)).w;
+}
+
+#endif // OCCLUSION_H
@@ -0,0 +1,94 @@
+#ifndef OFFSCREEN_H
+#define OFFSCREEN_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <iostream>
+
+// GL without a display, for benchmarks on CI machines: GLFW's null platform with an OSMesa
+// context (Mesa llvmpipe, no GPU or X server needed), or without libOSMesa a hidden window on
+// the default platform (e.g. under Xvfb); render into an OffscreenTarget, not the window
+
+// 3.3 core context made current with GLAD loaded, nullptr when neither backend works;
+// backend names the one that did, glfwTerminate() is the caller's
+GLFWwindow* createHeadlessContext(const char** backend = nullptr);
+
+// color + depth renderbuffers, bound as the draw framebuffer with a matching viewport
+struct OffscreenTarget {
+    GLuint framebuffer = 0, color = 0, depth = 0;
+
+    OffscreenTarget() = default;
+    ~OffscreenTarget();
+    OffscreenTarget(const OffscreenTarget&) = delete;
+    OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+
+    bool create(int width, int height);
+};
+
+// invisible window for the context only, its own framebuffer is never drawn to
+GLFWwindow* createHiddenWindow(int platform, int contextApi) {
+    glfwInitHint(GLFW_PLATFORM, platform);
+    if (!glfwInit()) {
+        return nullptr;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, contextApi);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "LearnOpenGL: headless", nullptr, nullptr);
+    if (!window) {
+        glfwTerminate();
+    }
+    return window;
+}
+
+GLFWwindow* createHeadlessContext(const char** backend) {
+    const char* name = "null+osmesa";
+    GLFWwindow* window = createHiddenWindow(GLFW_PLATFORM_NULL, GLFW_OSMESA_CONTEXT_API);
+    if (!window) {
+        name = "hidden window";
+        window = createHiddenWindow(GLFW_ANY_PLATFORM, GLFW_NATIVE_CONTEXT_API);
+    }
+    if (!window) {
+        std::cerr << "ERROR::OFFSCREEN: no OSMesa context and no display to create a hidden window on\n";
+        return nullptr;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
+        std::cerr << "Failed to initialize GLAD!\n";
+        glfwTerminate();
+        return nullptr;
+    }
+    if (backend) {
+        *backend = name;
+    }
+    return window;
+}
+
+OffscreenTarget::~OffscreenTarget() {
+    if (framebuffer && glfwGetCurrentContext()) {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &color);
+        glDeleteRenderbuffers(1, &depth);
+    }
+}
+
+bool OffscreenTarget::create(int width, int height) {
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glGenRenderbuffers(1, &color);
+    glBindRenderbuffer(GL_RENDERBUFFER, color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+    glViewport(0, 0, width, height);
+    return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+#endif // OFFSCREEN_H
@@ -0,0 +1,22 @@
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+#include <cstdint>
+
+// what the draw paths submitted since the last reset, counted on the GL thread
+struct RenderStats {
+    uint64_t drawCalls = 0; // GL draw commands, a multi-draw counts once
+    uint64_t triangles = 0; // over all instances
+
+    void reset() { *this = {}; }
+    // indexCount summed over the ranges of a multi-draw
+    void addDraw(uint64_t indexCount, uint64_t instanceCount = 1) {
+        drawCalls ++;
+        triangles += indexCount / 3 * instanceCount;
+    }
+};
+
+// reset by the frame loop, e.g. once per frame
+RenderStats renderStats;
+
+#endif // RENDER_STATS_H
@@ -0,0 +1,203 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <assimp/scene.h>
+
+#include "thread_pool.h"
+
+constexpr uint32_t SCENE_NO_PARENT = UINT32_MAX;
+// below this many nodes a dirty range is updated by one task
+constexpr size_t SCENE_UPDATE_GRAIN = 4096;
+
+// parent * local written out: in large translation units GCC stops inlining glm's operator*,
+// and the call passes vec4s around in halves, which made this loop ~10x slower
+inline void sceneMultiply(const glm::mat4& parent, const glm::mat4& local, glm::mat4& world) {
+    for (int c{}; c < 4; c ++) {
+        for (int r{}; r < 4; r ++) {
+            world[c][r] = parent[0][r] * local[c][0] + parent[1][r] * local[c][1] + parent[2][r] * local[c][2] + parent[3][r] * local[c][3];
+        }
+    }
+}
+
+// node transforms as structure of arrays in depth-first (pre-order) order, so a parent always
+// precedes its children and every subtree is one contiguous range [node, subtreeEnd(node));
+// setLocal() flags a node and update() recomputes only the flagged subtrees, in parallel
+class SceneGraph {
+public:
+    // append a node; parent must be SCENE_NO_PARENT or a node whose subtree is still open,
+    // i.e. the last node added or one of its ancestors (depth-first construction)
+    uint32_t addNode(uint32_t parent, const glm::mat4& local, std::string name = {});
+    // copy an Assimp hierarchy below parent, returns the id of root
+    uint32_t addAssimpNodes(const aiNode* root, uint32_t parent = SCENE_NO_PARENT);
+    void clear();
+
+    size_t size() const { return locals.size(); }
+    uint32_t parent(uint32_t node) const { return parents[node]; }
+    uint32_t subtreeEnd(uint32_t node) const { return ends[node] == SCENE_NO_PARENT ? static_cast<uint32_t>(size()) : ends[node]; }
+    const std::string& name(uint32_t node) const { return names[node]; }
+    // first node with the name, SCENE_NO_PARENT if there is none
+    uint32_t find(const std::string& name) const;
+
+    const glm::mat4& local(uint32_t node) const { return locals[node]; }
+    // valid after update()
+    const glm::mat4& world(uint32_t node) const { return worlds[node]; }
+    void setLocal(uint32_t node, const glm::mat4& local);
+
+    // recompute the world matrices below every node changed since the last call, returns how many
+    size_t update();
+private:
+    std::vector<glm::mat4> locals;
+    std::vector<glm::mat4> worlds;
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> ends;       // SCENE_NO_PARENT while the subtree is open, see subtreeEnd()
+    std::vector<uint32_t> openPath;   // the last node added and its ancestors, root first
+    std::vector<std::string> names;
+    std::vector<uint8_t> dirty;
+    std::vector<uint32_t> dirtyNodes;
+    // scratch of update(): contiguous ranges whose parents are already final
+    std::vector<std::pair<uint32_t, uint32_t>> ranges;
+
+    void updateRange(uint32_t first, uint32_t end);
+    void splitRange(uint32_t first, uint32_t end);
+};
+
+uint32_t SceneGraph::addNode(uint32_t parent, const glm::mat4& local, std::string name) {
+    auto node = static_cast<uint32_t>(locals.size());
+    if (parent != SCENE_NO_PARENT && (parent >= node || ends[parent] != SCENE_NO_PARENT)) {
+        std::cerr << "ERROR::SCENE_GRAPH: parent " << parent << " of node " << node << " is not open\n";
+        parent = SCENE_NO_PARENT;
+    }
+    // nodes below the parent on the open path get no more children, their subtrees end here
+    while (!openPath.empty() && openPath.back() != parent) {
+        ends[openPath.back()] = node;
+        openPath.pop_back();
+    }
+    openPath.push_back(node);
+
+    locals.push_back(local);
+    worlds.push_back(local);
+    if (parent != SCENE_NO_PARENT) {
+        sceneMultiply(worlds[parent], local, worlds.back());
+    }
+    parents.push_back(parent);
+    ends.push_back(SCENE_NO_PARENT);
+    names.push_back(std::move(name));
+    dirty.push_back(0);
+    return node;
+}
+
+uint32_t SceneGraph::addAssimpNodes(const aiNode* root, uint32_t parent) {
+    // aiMatrix4x4 is row-major, glm is column-major
+    const aiMatrix4x4& m = root->mTransformation;
+    glm::mat4 local(m.a1, m.b1, m.c1, m.d1, m.a2, m.b2, m.c2, m.d2, m.a3, m.b3, m.c3, m.d3, m.a4, m.b4, m.c4, m.d4);
+    uint32_t node = addNode(parent, local, root->mName.C_Str());
+    for (unsigned i{}; i < root->mNumChildren; i ++) {
+        addAssimpNodes(root->mChildren[i], node);
+    }
+    return node;
+}
+
+void SceneGraph::clear() {
+    locals.clear();
+    worlds.clear();
+    parents.clear();
+    ends.clear();
+    openPath.clear();
+    names.clear();
+    dirty.clear();
+    dirtyNodes.clear();
+}
+
+uint32_t SceneGraph::find(const std::string& name) const {
+    auto found = std::find(names.begin(), names.end(), name);
+    return found == names.end() ? SCENE_NO_PARENT : static_cast<uint32_t>(found - names.begin());
+}
+
+void SceneGraph::setLocal(uint32_t node, const glm::mat4& local) {
+    locals[node] = local;
+    if (!dirty[node]) {
+        dirty[node] = 1;
+        dirtyNodes.push_back(node);
+    }
+}
+
+size_t SceneGraph::update() {
+    if (dirtyNodes.empty()) {
+        return 0;
+    }
+    // pre-order makes subtree containment an interval test: after sorting, a flagged node
+    // inside the previous kept subtree is covered by it
+    std::sort(dirtyNodes.begin(), dirtyNodes.end());
+    ranges.clear();
+    size_t updated{};
+    uint32_t coveredEnd{};
+    for (auto node : dirtyNodes) {
+        dirty[node] = 0;
+        if (node < coveredEnd) {
+            continue;
+        }
+        coveredEnd = subtreeEnd(node);
+        updated += coveredEnd - node;
+        splitRange(node, coveredEnd);
+    }
+    dirtyNodes.clear();
+
+    ThreadPool::global().parallelFor(ranges.size(), [&](size_t i) { updateRange(ranges[i].first, ranges[i].second); });
+    return updated;
+}
+
+void SceneGraph::splitRange(uint32_t first, uint32_t end) {
+    // explicit stack, a long chain of big subtrees would otherwise recurse once per level
+    std::vector<std::pair<uint32_t, uint32_t>> pending{{first, end}};
+    while (!pending.empty()) {
+        auto [root, rootEnd] = pending.back();
+        pending.pop_back();
+        if (rootEnd - root <= SCENE_UPDATE_GRAIN) {
+            ranges.emplace_back(root, rootEnd);
+            continue;
+        }
+        // the root here, then its child subtrees as tasks; runs of small siblings are batched,
+        // which stays contiguous because siblings' subtrees follow each other
+        updateRange(root, root + 1);
+        uint32_t batch = root + 1;
+        for (uint32_t child = root + 1; child < rootEnd; child = subtreeEnd(child)) {
+            uint32_t childEnd = subtreeEnd(child);
+            if (childEnd - child > SCENE_UPDATE_GRAIN) {
+                if (batch < child) {
+                    ranges.emplace_back(batch, child);
+                }
+                pending.emplace_back(child, childEnd);
+                batch = childEnd;
+            } else if (childEnd - batch > SCENE_UPDATE_GRAIN) {
+                if (batch < child) {
+                    ranges.emplace_back(batch, child);
+                }
+                batch = child;
+            }
+        }
+        if (batch < rootEnd) {
+            ranges.emplace_back(batch, rootEnd);
+        }
+    }
+}
+
+void SceneGraph::updateRange(uint32_t first, uint32_t end) {
+    for (uint32_t node = first; node < end; node ++) {
+        uint32_t parent = parents[node];
+        if (parent == SCENE_NO_PARENT) {
+            worlds[node] = locals[node];
+        } else {
+            sceneMultiply(worlds[parent], locals[node], worlds[node]);
+        }
+    }
+}
+
+#endif // SCENE_GRAPH_H
@@ -21,6 +21,7 @@ public:
     void setInt1(const std::string&, int = 0) const;
     void setFloat1(const std::string&, float = 0.0f) const;
     void setFloat4(const std::string&, float = 0.0f, float = 0.0f, float = 0.0f, float = 1.0f) const;
+    void setMat3(const std::string&, const float*) const;
     void setMat4(const std::string&, const float*) const;
     void setVec3(const std::string&, const glm::vec3&) const;
 private:
@@ -47,7 +48,7 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
         fragmentCode = fShaderStream.str();
 
     } catch (std::ifstream::failure& e) {
-        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
+        std::cerr << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
     }
 
     const char* vShaderCode = vertexCode.c_str();
@@ -101,6 +102,10 @@ void Shader::setFloat1(const std::string& name, float val) const {
     glUniform1f(glGetUniformLocation(programID, name.c_str()), val);
 }
 
+void Shader::setMat3(const std::string& name, const float* val) const {
+    glUniformMatrix3fv(glGetUniformLocation(programID, name.c_str()), 1, GL_FALSE, val);
+}
+
 void Shader::setMat4(const std::string& name, const float* val) const {
     glUniformMatrix4fv(glGetUniformLocation(programID, name.c_str()), 1, GL_FALSE, val);
 }
@@ -116,13 +121,13 @@ void Shader::checkCompileError(GLuint shader, std::string type) {
         glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
         if (!success) {
             glGetShaderInfoLog(shader, 1024, nullptr, infoLog);
-            std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+            std::cerr << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
         }
     } else {
         glGetProgramiv(shader, GL_LINK_STATUS, &success);
         if (!success) {
             glGetProgramInfoLog(shader, 1024, nullptr, infoLog);
-            std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+            std::cerr << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
         }
     }
 }
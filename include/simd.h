@@ -0,0 +1,94 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cstdint>
+
+// minimal float vector for the culling loops: 8 lanes with AVX, 4 with SSE2, scalar otherwise
+// the width is fixed at compile time; CMake's ENABLE_AVX2 (on by default) adds -mavx2 when the
+// build machine supports it
+
+#if defined(__AVX__)
+#include <immintrin.h>
+
+constexpr unsigned SIMD_WIDTH = 8;
+
+struct SimdFloat {
+    __m256 v;
+};
+inline SimdFloat simdLoad(const float* p) { return {_mm256_loadu_ps(p)}; }
+inline void simdStore(float* p, SimdFloat a) { _mm256_storeu_ps(p, a.v); }
+inline SimdFloat simdSet(float x) { return {_mm256_set1_ps(x)}; }
+inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return {_mm256_sub_ps(a.v, b.v)}; }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return {_mm256_mul_ps(a.v, b.v)}; }
+inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return {_mm256_div_ps(a.v, b.v)}; }
+inline SimdFloat operator&(SimdFloat a, SimdFloat b) { return {_mm256_and_ps(a.v, b.v)}; }
+inline SimdFloat operator|(SimdFloat a, SimdFloat b) { return {_mm256_or_ps(a.v, b.v)}; }
+inline SimdFloat simdMin(SimdFloat a, SimdFloat b) { return {_mm256_min_ps(a.v, b.v)}; }
+inline SimdFloat simdMax(SimdFloat a, SimdFloat b) { return {_mm256_max_ps(a.v, b.v)}; }
+inline SimdFloat simdSqrt(SimdFloat a) { return {_mm256_sqrt_ps(a.v)}; }
+// comparisons return all-ones lanes where true
+inline SimdFloat simdLess(SimdFloat a, SimdFloat b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+inline SimdFloat simdGreaterEqual(SimdFloat a, SimdFloat b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)}; }
+// one bit per lane, lane 0 in bit 0
+inline unsigned simdMask(SimdFloat a) { return static_cast<unsigned>(_mm256_movemask_ps(a.v)); }
+// a where mask is set, b elsewhere
+inline SimdFloat simdSelect(SimdFloat mask, SimdFloat a, SimdFloat b) { return {_mm256_blendv_ps(b.v, a.v, mask.v)}; }
+
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+
+constexpr unsigned SIMD_WIDTH = 4;
+
+struct SimdFloat {
+    __m128 v;
+};
+inline SimdFloat simdLoad(const float* p) { return {_mm_loadu_ps(p)}; }
+inline void simdStore(float* p, SimdFloat a) { _mm_storeu_ps(p, a.v); }
+inline SimdFloat simdSet(float x) { return {_mm_set1_ps(x)}; }
+inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return {_mm_add_ps(a.v, b.v)}; }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return {_mm_div_ps(a.v, b.v)}; }
+inline SimdFloat operator&(SimdFloat a, SimdFloat b) { return {_mm_and_ps(a.v, b.v)}; }
+inline SimdFloat operator|(SimdFloat a, SimdFloat b) { return {_mm_or_ps(a.v, b.v)}; }
+inline SimdFloat simdMin(SimdFloat a, SimdFloat b) { return {_mm_min_ps(a.v, b.v)}; }
+inline SimdFloat simdMax(SimdFloat a, SimdFloat b) { return {_mm_max_ps(a.v, b.v)}; }
+inline SimdFloat simdSqrt(SimdFloat a) { return {_mm_sqrt_ps(a.v)}; }
+inline SimdFloat simdLess(SimdFloat a, SimdFloat b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+inline SimdFloat simdGreaterEqual(SimdFloat a, SimdFloat b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+inline unsigned simdMask(SimdFloat a) { return static_cast<unsigned>(_mm_movemask_ps(a.v)); }
+inline SimdFloat simdSelect(SimdFloat mask, SimdFloat a, SimdFloat b) { return {_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))}; }
+
+#else
+#include <cmath>
+#include <cstring>
+
+constexpr unsigned SIMD_WIDTH = 1;
+
+// masks keep the all-ones bit pattern so & and | behave like the vector versions
+struct SimdFloat {
+    float v;
+};
+inline uint32_t simdBits(float x) { uint32_t b; std::memcpy(&b, &x, 4); return b; }
+inline float simdFloat(uint32_t b) { float x; std::memcpy(&x, &b, 4); return x; }
+inline SimdFloat simdLoad(const float* p) { return {*p}; }
+inline void simdStore(float* p, SimdFloat a) { *p = a.v; }
+inline SimdFloat simdSet(float x) { return {x}; }
+inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return {a.v + b.v}; }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return {a.v - b.v}; }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return {a.v * b.v}; }
+inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return {a.v / b.v}; }
+inline SimdFloat operator&(SimdFloat a, SimdFloat b) { return {simdFloat(simdBits(a.v) & simdBits(b.v))}; }
+inline SimdFloat operator|(SimdFloat a, SimdFloat b) { return {simdFloat(simdBits(a.v) | simdBits(b.v))}; }
+inline SimdFloat simdMin(SimdFloat a, SimdFloat b) { return {a.v < b.v ? a.v : b.v}; }
+inline SimdFloat simdMax(SimdFloat a, SimdFloat b) { return {a.v > b.v ? a.v : b.v}; }
+inline SimdFloat simdSqrt(SimdFloat a) { return {std::sqrt(a.v)}; }
+inline SimdFloat simdLess(SimdFloat a, SimdFloat b) { return {simdFloat(a.v < b.v ? ~0u : 0u)}; }
+inline SimdFloat simdGreaterEqual(SimdFloat a, SimdFloat b) { return {simdFloat(a.v >= b.v ? ~0u : 0u)}; }
+inline unsigned simdMask(SimdFloat a) { return simdBits(a.v) >> 31; }
+inline SimdFloat simdSelect(SimdFloat mask, SimdFloat a, SimdFloat b) { return simdBits(mask.v) ? a : b; }
+
+#endif
+
+#endif // SIMD_H
@@ -0,0 +1,217 @@
+#ifndef STRESS_SCENE_H
+#define STRESS_SCENE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "baked_texture.h"
+#include "hash.h"
+#include "model.h"
+
+#ifndef STB_IMAGE_WRITE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#endif
+#include "stb_image_write.h"
+
+// procedural scenes for scaling benchmarks: <directory>/stress.obj with stress.mtl and
+// texture_<i>.png, every count configurable; the same config and seed always write the same files
+
+struct StressSceneConfig {
+    unsigned meshes = 16;            // one OBJ object each, laid out on a cube grid
+    unsigned verticesPerMesh = 4096; // rounded to a square lattice wrapped around a bumpy sphere
+    unsigned materials = 4;          // mesh i uses material i % materials, raised to textures
+    unsigned textures = 4;           // material m samples texture m % textures, 0 for colours only
+    unsigned textureSize = 256;      // RGB, power of two keeps the mip chain simple
+    unsigned instances = 1;          // copies of the whole scene when drawn, nothing is written for them
+    uint32_t seed = 1;
+    bool bakeCaches = false;         // also write the .meshcache and .ltex files, so the first load is warm
+};
+
+struct StressSceneStats {
+    std::string path; // the .obj
+    size_t vertices = 0;
+    size_t triangles = 0;
+    size_t fileBytes = 0; // .obj + .mtl + .png, caches excluded
+};
+
+// write the scene into directory (created if missing), false on any I/O error
+bool writeStressScene(const std::string& directory, const StressSceneConfig& config, StressSceneStats* stats = nullptr);
+// square grid of config.instances scene copies on the XZ plane, spaced by the scene's extent
+std::vector<glm::mat4> stressSceneInstances(const StressSceneConfig& config);
+// half the edge of the cube the meshes occupy
+float stressSceneExtent(const StressSceneConfig& config);
+
+float stressSceneExtent(const StressSceneConfig& config) {
+    unsigned side = static_cast<unsigned>(std::ceil(std::cbrt(static_cast<double>(std::max(config.meshes, 1u)))));
+    return side * 1.25f;
+}
+
+std::vector<glm::mat4> stressSceneInstances(const StressSceneConfig& config) {
+    unsigned count = std::max(config.instances, 1u);
+    unsigned side = static_cast<unsigned>(std::ceil(std::sqrt(static_cast<double>(count))));
+    float spacing = stressSceneExtent(config) * 2.5f;
+    std::vector<glm::mat4> transforms(count);
+    for (unsigned i{}; i < count; i ++) {
+        glm::vec3 offset((float(i % side) - (side - 1) * 0.5f) * spacing, 0.0f, (float(i / side) - (side - 1) * 0.5f) * spacing);
+        transforms[i] = glm::translate(glm::mat4(1.0f), offset);
+    }
+    return transforms;
+}
+
+// checker of two colours derived from the index, with a gradient so every mip level differs
+std::vector<unsigned char> stressTexturePixels(unsigned index, unsigned size) {
+    std::vector<unsigned char> pixels(size_t(size) * size * 3);
+    std::mt19937 random(index * 7919u + 1u);
+    std::uniform_int_distribution<int> channel(40, 255);
+    unsigned char a[3], b[3];
+    for (int c{}; c < 3; c ++) {
+        a[c] = static_cast<unsigned char>(channel(random));
+        b[c] = static_cast<unsigned char>(channel(random) / 3);
+    }
+    unsigned cell = std::max(size / 8, 1u);
+    for (unsigned y{}; y < size; y ++) {
+        for (unsigned x{}; x < size; x ++) {
+            const unsigned char* colour = ((x / cell) + (y / cell)) % 2 ? a : b;
+            unsigned char* pixel = &pixels[(size_t(y) * size + x) * 3];
+            for (int c{}; c < 3; c ++) {
+                pixel[c] = static_cast<unsigned char>(colour[c] * (192 + 63 * x / size) / 255);
+            }
+        }
+    }
+    return pixels;
+}
+
+bool writeStressScene(const std::string& directory, const StressSceneConfig& config, StressSceneStats* stats) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) {
+        std::cerr << "ERROR::STRESS_SCENE: cannot create " << directory << '\n';
+        return false;
+    }
+    StressSceneStats result;
+    result.path = directory + "/stress.obj";
+    unsigned materials = std::max({config.materials, config.textures, 1u});
+    unsigned textureSize = std::max(config.textureSize, 1u);
+
+    // textures, hashed as encoded so a baked .ltex matches what loadBakedTexture computes
+    for (unsigned t{}; t < config.textures; t ++) {
+        std::vector<unsigned char> pixels = stressTexturePixels(t, textureSize);
+        std::vector<unsigned char> png;
+        stbi_write_png_to_func([](void* context, void* data, int size) {
+            auto* out = static_cast<std::vector<unsigned char>*>(context);
+            out->insert(out->end(), static_cast<unsigned char*>(data), static_cast<unsigned char*>(data) + size);
+        }, &png, textureSize, textureSize, 3, pixels.data(), textureSize * 3);
+        std::string path = directory + "/texture_" + std::to_string(t) + ".png";
+        FILE* file = std::fopen(path.c_str(), "wb");
+        bool written = file && !png.empty() && std::fwrite(png.data(), 1, png.size(), file) == png.size();
+        if (file && std::fclose(file) != 0) {
+            written = false;
+        }
+        if (!written) {
+            std::cerr << "ERROR::STRESS_SCENE: failed to write " << path << '\n';
+            return false;
+        }
+        result.fileBytes += png.size();
+        if (config.bakeCaches && !bakeTexture(pixels.data(), textureSize, textureSize, 3, hashBytes(png.data(), png.size()), path + BAKED_TEXTURE_EXTENSION)) {
+            std::cerr << "WARNING::STRESS_SCENE: failed to bake " << path << '\n';
+        }
+    }
+
+    std::string mtlPath = directory + "/stress.mtl";
+    FILE* mtl = std::fopen(mtlPath.c_str(), "w");
+    if (!mtl) {
+        std::cerr << "ERROR::STRESS_SCENE: failed to write " << mtlPath << '\n';
+        return false;
+    }
+    std::mt19937 random(config.seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (unsigned m{}; m < materials; m ++) {
+        std::fprintf(mtl, "newmtl material_%u\nKa 0.1 0.1 0.1\nKd %.3f %.3f %.3f\nKs 0.5 0.5 0.5\nNs 32\n",
+            m, 0.2f + 0.8f * unit(random), 0.2f + 0.8f * unit(random), 0.2f + 0.8f * unit(random));
+        if (config.textures) {
+            std::fprintf(mtl, "map_Kd texture_%u.png\n", m % config.textures);
+        }
+        std::fprintf(mtl, "\n");
+    }
+    long mtlBytes = std::ftell(mtl);
+    if (std::fclose(mtl) != 0 || mtlBytes < 0) {
+        std::cerr << "ERROR::STRESS_SCENE: failed to write " << mtlPath << '\n';
+        return false;
+    }
+    result.fileBytes += static_cast<size_t>(mtlBytes);
+
+    FILE* obj = std::fopen(result.path.c_str(), "w");
+    if (!obj) {
+        std::cerr << "ERROR::STRESS_SCENE: failed to write " << result.path << '\n';
+        return false;
+    }
+    std::vector<char> buffer(size_t(1) << 20);
+    std::setvbuf(obj, buffer.data(), _IOFBF, buffer.size());
+    std::fprintf(obj, "# stress scene: %u meshes x %u vertices, %u materials, %u textures, seed %u\nmtllib stress.mtl\n",
+        config.meshes, config.verticesPerMesh, materials, config.textures, config.seed);
+
+    unsigned lattice = std::max(2u, static_cast<unsigned>(std::lround(std::sqrt(static_cast<double>(config.verticesPerMesh)))));
+    unsigned side = static_cast<unsigned>(std::ceil(std::cbrt(static_cast<double>(std::max(config.meshes, 1u)))));
+    float extent = stressSceneExtent(config);
+    size_t base = 1; // OBJ indices are global and 1-based
+    for (unsigned i{}; i < config.meshes; i ++) {
+        glm::vec3 centre(float(i % side) * 2.5f + 1.25f - extent, float(i / side % side) * 2.5f + 1.25f - extent,
+            float(i / (side * side)) * 2.5f + 1.25f - extent);
+        // a few random bumps per mesh, so no two meshes and no two cache entries are alike
+        float frequency = 2.0f + 4.0f * unit(random), amplitude = 0.05f + 0.1f * unit(random), phase = 6.2831853f * unit(random);
+        std::fprintf(obj, "o mesh_%u\nusemtl material_%u\n", i, i % materials);
+        for (unsigned y{}; y < lattice; y ++) {
+            float v = float(y) / (lattice - 1);
+            float theta = v * 3.14159265f;
+            for (unsigned x{}; x < lattice; x ++) {
+                float u = float(x) / (lattice - 1);
+                float phi = u * 6.2831853f;
+                glm::vec3 normal(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+                float radius = 1.0f + amplitude * std::sin(frequency * phi + phase) * std::sin(frequency * theta);
+                glm::vec3 position = centre + normal * radius;
+                std::fprintf(obj, "v %.5f %.5f %.5f\nvt %.5f %.5f\nvn %.4f %.4f %.4f\n",
+                    position.x, position.y, position.z, u, v, normal.x, normal.y, normal.z);
+            }
+        }
+        for (unsigned y{}; y + 1 < lattice; y ++) {
+            for (unsigned x{}; x + 1 < lattice; x ++) {
+                // counter-clockwise from outside: b is the next phi, c the next theta (downwards)
+                size_t a = base + size_t(y) * lattice + x, b = a + 1, c = a + lattice, d = c + 1;
+                std::fprintf(obj, "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\nf %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n",
+                    a, a, a, b, b, b, c, c, c, b, b, b, d, d, d, c, c, c);
+            }
+        }
+        base += size_t(lattice) * lattice;
+        result.vertices += size_t(lattice) * lattice;
+        result.triangles += size_t(lattice - 1) * (lattice - 1) * 2;
+    }
+    long objBytes = std::ftell(obj);
+    if (std::fclose(obj) != 0 || objBytes < 0) {
+        std::cerr << "ERROR::STRESS_SCENE: failed to write " << result.path << '\n';
+        return false;
+    }
+    result.fileBytes += static_cast<size_t>(objBytes);
+
+    // a CPU-only load writes the mesh cache for the default ModelConfig
+    if (config.bakeCaches) {
+        ModelData data;
+        if (!Model::readData(result.path, ModelConfig{}, data)) {
+            std::cerr << "WARNING::STRESS_SCENE: failed to write the mesh cache of " << result.path << '\n';
+        }
+    }
+    if (stats) {
+        *stats = result;
+    }
+    return true;
+}
+
+#endif // STRESS_SCENE_H
@@ -0,0 +1,142 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <assimp/texture.h>
+
+#include "hash.h"
+#include "mapped_file.h"
+
+// GL texture owned by the handles that share it, deleted with the last one
+struct TextureResource {
+    unsigned id;
+
+    explicit TextureResource(unsigned id): id(id) {}
+    TextureResource(const TextureResource&) = delete;
+    TextureResource& operator=(const TextureResource&) = delete;
+    ~TextureResource();
+};
+using TextureHandle = std::shared_ptr<TextureResource>;
+
+// sampler state baked into a texture object, part of the cache key
+struct SamplerParams {
+    GLint wrapMode;
+    GLint magFilter;
+    GLint minFilter;
+};
+
+// process-wide textures keyed by image content plus sampler state, so models that share
+// an atlas (by path or as identical embedded data) share one GL texture
+class TextureCache {
+public:
+    static TextureCache& global();
+
+    // content hash of a file (memoized per path) or of embedded data, 0 if unreadable
+    uint64_t fileKey(const std::string& fileName);
+    uint64_t embeddedKey(const aiTexture* aiTex) const;
+
+    // live texture for the key, or a new one from create() (returns a TextureHandle); key 0 is never shared
+    template <typename F>
+    TextureHandle acquire(uint64_t contentKey, const SamplerParams& sampler, F&& create);
+
+    // textures alive right now
+    size_t size();
+private:
+    struct Key {
+        uint64_t content;
+        SamplerParams sampler;
+
+        bool operator==(const Key& other) const {
+            return content == other.content && sampler.wrapMode == other.sampler.wrapMode
+                && sampler.magFilter == other.sampler.magFilter && sampler.minFilter == other.sampler.minFilter;
+        }
+    };
+    // field by field: Key has tail padding after the sampler, hashing its bytes would read garbage
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            GLint sampler[3] = {key.sampler.wrapMode, key.sampler.magFilter, key.sampler.minFilter};
+            return static_cast<size_t>(hashBytes(sampler, sizeof(sampler), hashBytes(&key.content, sizeof(key.content))));
+        }
+    };
+
+    std::mutex mutex;
+    std::unordered_map<Key, std::weak_ptr<TextureResource>, KeyHash> textures;
+    std::unordered_map<std::string, uint64_t> fileHashes;
+};
+
+TextureResource::~TextureResource() {
+    // skips threads without a current context; after glfwTerminate() GLFW cannot answer this,
+    // so models owning textures must be destroyed before it
+    if (id && glfwGetCurrentContext()) {
+        glDeleteTextures(1, &id);
+    }
+}
+
+TextureCache& TextureCache::global() {
+    static TextureCache cache;
+    return cache;
+}
+
+uint64_t TextureCache::fileKey(const std::string& fileName) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = fileHashes.find(fileName);
+        if (found != fileHashes.end()) {
+            return found->second;
+        }
+    }
+    MappedFile file(fileName);
+    uint64_t key = file.isOpen() ? hashBytes(file.data(), file.size()) : 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    fileHashes[fileName] = key;
+    return key;
+}
+
+uint64_t TextureCache::embeddedKey(const aiTexture* aiTex) const {
+    if (!aiTex || !aiTex->pcData) {
+        return 0;
+    }
+    // compressed data has mHeight 0 and mWidth bytes, raw data is mWidth * mHeight texels
+    size_t size = aiTex->mHeight == 0 ? aiTex->mWidth : size_t(aiTex->mWidth) * aiTex->mHeight * sizeof(aiTexel);
+    return hashBytes(aiTex->pcData, size, hashBytes(&aiTex->mHeight, sizeof(aiTex->mHeight)));
+}
+
+template <typename F>
+TextureHandle TextureCache::acquire(uint64_t contentKey, const SamplerParams& sampler, F&& create) {
+    if (contentKey == 0) {
+        return create();
+    }
+    Key key{contentKey, sampler};
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& slot = textures[key];
+    if (auto texture = slot.lock()) {
+        return texture;
+    }
+    auto texture = create();
+    slot = texture;
+    return texture;
+}
+
+size_t TextureCache::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t alive{};
+    for (auto it = textures.begin(); it != textures.end();) {
+        if (it->second.expired()) {
+            it = textures.erase(it);
+        } else {
+            alive ++;
+            ++ it;
+        }
+    }
+    return alive;
+}
+
+#endif // TEXTURE_CACHE_H
@@ -0,0 +1,251 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <assimp/texture.h>
+
+#include "baked_texture.h"
+#include "stb_image.h"
+#include "texture_cache.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+// image decoded on a worker thread, waiting for its upload on the GL thread
+struct DecodedImage {
+    std::weak_ptr<TextureResource> texture; // expired once the last handle let go, the id may be reused by then
+    int width, height;
+    GLenum format;
+    int channels;  // bytes per pixel of pixels, as the decoder returned them
+    unsigned char* pixels;
+    bool fromStbi; // stbi memory must be released with stbi_image_free
+    std::shared_ptr<BakedTexture> baked; // set instead of pixels when a baked mip chain was found
+};
+
+// decodes textures on the worker pool and uploads them through a pixel buffer object
+// the GL id is created immediately and holds a 1x1 placeholder until poll() uploads the image,
+// so meshes keep the id they were built with and switch to the real image in place;
+// a texture whose handles are all gone by then is skipped
+class AsyncTextureLoader {
+public:
+    ~AsyncTextureLoader();
+
+    static AsyncTextureLoader& global();
+
+    // queue a file/embedded texture, return its placeholder right away
+    TextureHandle requestFile(const std::string& fileName, GLint wrapMode, GLint MagFilterMode, GLint MinFilterMode);
+    TextureHandle requestAssimp(const aiTexture* aiTex, GLint wrapMode, GLint MagFilterMode, GLint MinFilterMode);
+
+    // upload up to maxUploads decoded images, call on the GL thread (e.g. once per frame)
+    unsigned poll(unsigned maxUploads = ~0u);
+    // block until every queued texture is uploaded
+    void flush();
+
+    unsigned pending() const { return inFlight.load() + static_cast<unsigned>(readyCount.load()); }
+private:
+    std::mutex mutex;
+    std::condition_variable decoded;
+    std::vector<DecodedImage> ready;
+    std::atomic<unsigned> inFlight{0};
+    std::atomic<size_t> readyCount{0};
+    GLuint pbo = 0;
+
+    unsigned createPlaceholder(GLint wrapMode, GLint MagFilterMode, GLint MinFilterMode);
+    void push(DecodedImage image);
+    void upload(const DecodedImage& image);
+};
+
+AsyncTextureLoader::~AsyncTextureLoader() {
+    // workers may still hold a pointer to us
+    std::unique_lock<std::mutex> lock(mutex);
+    decoded.wait(lock, [this] { return inFlight.load() == 0; });
+    for (auto& image : ready) {
+        if (image.baked) {
+            continue;
+        } else if (image.fromStbi) {
+            stbi_image_free(image.pixels);
+        } else {
+            delete[] image.pixels;
+        }
+    }
+}
+
+AsyncTextureLoader& AsyncTextureLoader::global() {
+    static AsyncTextureLoader loader;
+    return loader;
+}
+
+unsigned AsyncTextureLoader::createPlaceholder(GLint wrapMode, GLint MagFilterMode, GLint MinFilterMode) {
+    static const unsigned char white[4] = {255, 255, 255, 255};
+
+    unsigned textureID{};
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, MinFilterMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, MagFilterMode);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return textureID;
+}
+
+void AsyncTextureLoader::push(DecodedImage image) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (image.pixels || image.baked) {
+        ready.push_back(image);
+        readyCount = ready.size();
+    }
+    inFlight --;
+    decoded.notify_all();
+}
+
+TextureHandle AsyncTextureLoader::requestFile(const std::string& fileName, GLint wrapMode, GLint MagFilterMode, GLint MinFilterMode) {
+    auto texture = std::make_shared<TextureResource>(createPlaceholder(wrapMode, MagFilterMode, MinFilterMode));
+    inFlight ++;
+    ThreadPool::global().submit([this, target = std::weak_ptr<TextureResource>(texture), fileName] {
+        auto baked = std::make_shared<BakedTexture>();
+        if (loadBakedTexture(fileName, *baked)) {
+            push({target, 0, 0, GL_NONE, 0, nullptr, false, baked});
+            return;
+        }
+        TRACE_SCOPE("stbi_load");
+        int width, height, nrComponents;
+        unsigned char* data = stbi_load(fileName.c_str(), &width, &height, &nrComponents, 0);
+        if (!data) {
+            std::cerr << "Texture failed to load at path: " << fileName << '\n';
+        }
+        push({target, width, height, formatFromChannels(nrComponents), nrComponents, data, true});
+    });
+    return texture;
+}
+
+TextureHandle AsyncTextureLoader::requestAssimp(const aiTexture* aiTex, GLint wrapMode, GLint MagFilterMode, GLint MinFilterMode) {
+    if (!aiTex) {
+        return std::make_shared<TextureResource>(0);
+    }
+    auto texture = std::make_shared<TextureResource>(createPlaceholder(wrapMode, MagFilterMode, MinFilterMode));
+
+    // the aiScene dies with the importer, keep our own copy of the payload
+    bool compressed = aiTex->mHeight == 0;
+    size_t size = compressed ? aiTex->mWidth : size_t(aiTex->mWidth) * aiTex->mHeight * sizeof(aiTexel);
+    std::vector<unsigned char> bytes(size);
+    std::memcpy(bytes.data(), aiTex->pcData, size);
+    int texelWidth = aiTex->mWidth, texelHeight = aiTex->mHeight;
+
+    inFlight ++;
+    ThreadPool::global().submit([this, target = std::weak_ptr<TextureResource>(texture), compressed, texelWidth, texelHeight, bytes = std::move(bytes)] {
+        if (compressed) {
+            TRACE_SCOPE("stbi_load_from_memory");
+            int width, height, nrChannels;
+            unsigned char* data = stbi_load_from_memory(bytes.data(), static_cast<int>(bytes.size()), &width, &height, &nrChannels, 0);
+            push({target, width, height, formatFromChannels(nrChannels), nrChannels, data, true});
+        } else {
+            // raw aiTexel data is stored as BGRA8888
+            auto data = new unsigned char[bytes.size()];
+            std::memcpy(data, bytes.data(), bytes.size());
+            push({target, texelWidth, texelHeight, GL_BGRA, 4, data, false});
+        }
+    });
+    return texture;
+}
+
+void AsyncTextureLoader::upload(const DecodedImage& image) {
+    TRACE_SCOPE("AsyncTextureLoader::upload");
+    // the last handle may have deleted the texture while it was decoding, and glGenTextures may
+    // have handed its name to an unrelated texture since, so the id alone proves nothing
+    auto texture = image.texture.lock();
+    if (!texture) {
+        return;
+    }
+    if (image.baked) { // mip chain is uploaded straight from the mapping
+        glBindTexture(GL_TEXTURE_2D, texture->id);
+        image.baked->upload();
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return;
+    }
+
+    GLenum internalFormat = image.format == GL_BGRA ? GL_RGBA : image.format;
+    GLsizeiptr size = GLsizeiptr(image.width) * image.height * image.channels;
+
+    if (!pbo) {
+        glGenBuffers(1, &pbo);
+    }
+    // orphan the previous storage so the copy never waits on an earlier transfer
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (dst) {
+        std::memcpy(dst, image.pixels, size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+
+    GLint alignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    glBindTexture(GL_TEXTURE_2D, texture->id);
+    {
+        TRACE_SCOPE("glTexImage2D");
+        if (dst) {
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, image.width, image.height, 0, image.format, GL_UNSIGNED_BYTE, nullptr);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (!dst) { // mapping failed, fall back to a client-memory upload
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, image.width, image.height, 0, image.format, GL_UNSIGNED_BYTE, image.pixels);
+        }
+    }
+    {
+        TRACE_SCOPE("glGenerateMipmap");
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+}
+
+unsigned AsyncTextureLoader::poll(unsigned maxUploads) {
+    std::vector<DecodedImage> batch;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t count = std::min<size_t>(ready.size(), maxUploads);
+        batch.assign(ready.begin(), ready.begin() + count);
+        ready.erase(ready.begin(), ready.begin() + count);
+        readyCount = ready.size();
+    }
+
+    for (auto& image : batch) {
+        upload(image);
+        if (image.baked) {
+            continue;
+        } else if (image.fromStbi) {
+            stbi_image_free(image.pixels);
+        } else {
+            delete[] image.pixels;
+        }
+    }
+    return static_cast<unsigned>(batch.size());
+}
+
+void AsyncTextureLoader::flush() {
+    while (true) {
+        poll();
+        std::unique_lock<std::mutex> lock(mutex);
+        if (inFlight.load() == 0 && ready.empty()) {
+            return;
+        }
+        decoded.wait(lock, [this] { return inFlight.load() == 0 || !ready.empty(); });
+    }
+}
+
+#endif // TEXTURE_LOADER_H
@@ -0,0 +1,149 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "trace.h"
+
+// fixed-size worker pool, tasks run in FIFO order
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // process-wide pool, one worker per core besides the calling thread
+    static ThreadPool& global();
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+    // queue a task and return its future
+    template <typename F>
+    auto submit(F&& task) -> std::future<std::invoke_result_t<F>>;
+
+    // run fn(i) for every i in [0, count), the calling thread takes part
+    // safe to nest: the caller never waits on a task that has not started
+    template <typename F>
+    void parallelFor(size_t count, F&& fn);
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+
+    void enqueue(std::function<void()> task);
+    void workerLoop();
+};
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+    for (unsigned i{}; i < std::max(threadCount, 1u); i ++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::global() {
+    static ThreadPool pool(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+    return pool;
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    condition.notify_one();
+}
+
+void ThreadPool::workerLoop() {
+    TraceRecorder::global().setThreadName("pool worker");
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+template <typename F>
+auto ThreadPool::submit(F&& task) -> std::future<std::invoke_result_t<F>> {
+    using Result = std::invoke_result_t<F>;
+    // std::function needs a copyable target, packaged_task is move-only
+    auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+    auto future = packaged->get_future();
+    enqueue([packaged] { (*packaged)(); });
+    return future;
+}
+
+template <typename F>
+void ThreadPool::parallelFor(size_t count, F&& fn) {
+    if (count == 0) {
+        return;
+    }
+
+    // shared so helpers that start after the loop finished never touch the caller's stack
+    struct State {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        size_t count;
+        std::function<void(size_t)> body;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto state = std::make_shared<State>();
+    state->count = count;
+    state->body = std::ref(fn);
+
+    auto run = [](State& s) {
+        size_t completed{};
+        for (size_t i = s.next.fetch_add(1); i < s.count; i = s.next.fetch_add(1)) {
+            s.body(i);
+            completed ++;
+        }
+        if (completed && s.done.fetch_add(completed) + completed == s.count) {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            s.finished.notify_all();
+        }
+    };
+
+    size_t helpers = std::min<size_t>(size(), count - 1);
+    for (size_t i{}; i < helpers; i ++) {
+        enqueue([state, run] { run(*state); });
+    }
+    run(*state);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&state] { return state->done.load() == state->count; });
+}
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,185 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define TRACE_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACE_TSC 1
+#endif
+
+// scoped trace markers: TRACE_SCOPE("stbi_load") records the enclosing block
+// run with LEARNOPENGL_TRACE=<file.json> to record; at exit every thread's ring is written as a
+// Chrome trace (chrome://tracing or ui.perfetto.dev), without it a scope only tests traceEnabled
+
+// events kept per thread, older ones are overwritten
+constexpr size_t TRACE_RING_SIZE = size_t(1) << 16;
+
+struct TraceEvent {
+    const char* name; // string literal, never copied
+    uint64_t begin;   // TraceRecorder::now() ticks
+    uint64_t end;
+};
+
+// written only by its own thread; count is published after the slot, so the exporter never
+// reads a half-written event from a thread that has gone quiet
+struct TraceRing {
+    std::unique_ptr<TraceEvent[]> events{new TraceEvent[TRACE_RING_SIZE]};
+    std::atomic<uint64_t> count{0}; // events ever written
+    uint32_t threadId;
+    std::string threadName;
+};
+
+class TraceRecorder {
+public:
+    static TraceRecorder& global();
+    ~TraceRecorder();
+
+    // path from LEARNOPENGL_TRACE, empty when tracing is off
+    const std::string& path() const { return mPath; }
+    // this thread's ring, registered on first use
+    TraceRing& ring();
+    // label for the calling thread in the trace viewer
+    void setThreadName(const std::string& name);
+    // everything recorded so far as a Chrome trace JSON file
+    bool write(const std::string& path);
+
+    // timestamps are TSC ticks where there is one (~10 ns to read, steady_clock is 20-30),
+    // converted to nanoseconds against steady_clock on export
+    static uint64_t now();
+private:
+    std::string mPath;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceRing>> rings; // outlive their threads
+    uint64_t startTicks;
+    std::chrono::steady_clock::time_point startTime;
+
+    TraceRecorder();
+};
+
+// set at startup from LEARNOPENGL_TRACE; a benchmark may flip it to measure the enabled path
+bool traceEnabled = !TraceRecorder::global().path().empty();
+thread_local TraceRing* traceThreadRing = nullptr;
+
+class TraceScope {
+public:
+    explicit TraceScope(const char* name) {
+        if (traceEnabled) {
+            ring = traceThreadRing ? traceThreadRing : &TraceRecorder::global().ring();
+            this->name = name;
+            begin = TraceRecorder::now();
+        }
+    }
+    ~TraceScope() { end(); }
+    // close before the block does, e.g. between the phases of a frame
+    void end() {
+        if (ring) {
+            uint64_t n = ring->count.load(std::memory_order_relaxed);
+            ring->events[n & (TRACE_RING_SIZE - 1)] = {name, begin, TraceRecorder::now()};
+            ring->count.store(n + 1, std::memory_order_release);
+            ring = nullptr;
+        }
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+private:
+    TraceRing* ring = nullptr;
+    const char* name;
+    uint64_t begin;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+
+TraceRecorder::TraceRecorder(): startTicks(now()), startTime(std::chrono::steady_clock::now()) {
+    if (const char* path = std::getenv("LEARNOPENGL_TRACE")) {
+        mPath = path;
+    }
+}
+
+TraceRecorder::~TraceRecorder() {
+    if (!mPath.empty() && !write(mPath)) {
+        std::cerr << "ERROR::TRACE: failed to write " << mPath << '\n';
+    }
+}
+
+TraceRecorder& TraceRecorder::global() {
+    static TraceRecorder recorder;
+    return recorder;
+}
+
+uint64_t TraceRecorder::now() {
+#ifdef TRACE_TSC
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+TraceRing& TraceRecorder::ring() {
+    if (!traceThreadRing) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& ring = rings.emplace_back(std::make_unique<TraceRing>());
+        ring->threadId = static_cast<uint32_t>(rings.size());
+        traceThreadRing = ring.get();
+    }
+    return *traceThreadRing;
+}
+
+void TraceRecorder::setThreadName(const std::string& name) {
+    if (traceEnabled) {
+        auto& thread = ring();
+        std::lock_guard<std::mutex> lock(mutex);
+        thread.threadName = name;
+    }
+}
+
+bool TraceRecorder::write(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    // ticks per nanosecond over the whole run, 1 without a TSC
+    double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startTime).count();
+    uint64_t ticks = now() - startTicks;
+#ifdef TRACE_TSC
+    double nanosecondsPerTick = ticks && elapsed > 0.0 ? elapsed / double(ticks) : 1.0;
+#else
+    double nanosecondsPerTick = 1.0;
+#endif
+    auto microseconds = [&](uint64_t t) { return double(int64_t(t - startTicks)) * nanosecondsPerTick * 1e-3; };
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+    for (auto& ring : rings) {
+        std::string threadName = ring->threadName.empty() ? "thread " + std::to_string(ring->threadId) : ring->threadName;
+        std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+            first ? "" : ",\n", ring->threadId, threadName.c_str());
+        first = false;
+        uint64_t count = ring->count.load(std::memory_order_acquire);
+        for (uint64_t n = count > TRACE_RING_SIZE ? count - TRACE_RING_SIZE : 0; n < count; n ++) {
+            auto& event = ring->events[n & (TRACE_RING_SIZE - 1)];
+            // names are literals of ours, no escaping needed; ts/dur are microseconds with ns digits
+            std::fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                event.name, ring->threadId, microseconds(event.begin), double(event.end - event.begin) * nanosecondsPerTick * 1e-3);
+        }
+    }
+    std::fprintf(file, "\n]}\n");
+    return std::fclose(file) == 0;
+}
+
+#endif // TRACE_H
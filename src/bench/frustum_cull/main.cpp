@@ -0,0 +1,85 @@
+/*
+ * frustum culling throughput: cullBoxes (SoA, SIMD_WIDTH lanes) vs a scalar loop over Frustum::boxVisible
+ * usage: bench_frustum_cull [instances] [--frames N]
+ * instances (default 100000) are unit boxes under random transforms scattered in a 400 m cube,
+ * the camera spins at the center so every frame sees a different slice of them
+*/
+#include "header.h"
+#include "../bench_util.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+int main(int argc, char** argv) {
+    size_t instances = 100000;
+    unsigned frames = 200;
+    for (int i = 1; i < argc; i ++) {
+        std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc) {
+            frames = std::max(1, std::atoi(argv[++ i]));
+        } else {
+            instances = std::max(1, std::atoi(arg.c_str()));
+        }
+    }
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> place(-200.0f, 200.0f), angle(0.0f, 6.2831853f), size(0.5f, 3.0f);
+    std::vector<glm::mat4> transforms(instances);
+    for (auto& transform : transforms) {
+        transform = glm::translate(glm::mat4(1.0f), glm::vec3(place(random), place(random), place(random)));
+        transform = glm::rotate(transform, angle(random), glm::normalize(glm::vec3(1.0f, 2.0f, 3.0f)));
+        transform = glm::scale(transform, glm::vec3(size(random)));
+    }
+
+    // what ModelInstance::upload does whenever transforms change
+    BoxSet boxes;
+    auto start = std::chrono::steady_clock::now();
+    for (auto& transform : transforms) {
+        boxes.push(glm::vec3(0.0f), glm::vec3(0.5f), transform);
+    }
+    double buildMilliseconds = millisecondsSince(start);
+
+    Camera camera(glm::vec3(0.0f));
+    camera.aspect = 16.0f / 9.0f;
+    camera.farPlane = 300.0f;
+    std::vector<Frustum> frustums(frames);
+    for (unsigned f{}; f < frames; f ++) {
+        camera.processMouseMovement(360.0f / camera.mouseSensitivity / frames, 0.0f);
+        frustums[f] = camera.frustum();
+    }
+
+    std::vector<uint32_t> visible;
+    size_t simdVisible{}, scalarVisible{};
+    start = std::chrono::steady_clock::now();
+    for (auto& frustum : frustums) {
+        cullBoxes(boxes, frustum, visible);
+        simdVisible += visible.size();
+    }
+    double simdMilliseconds = millisecondsSince(start) / frames;
+
+    start = std::chrono::steady_clock::now();
+    for (auto& frustum : frustums) {
+        visible.clear();
+        for (size_t i{}; i < boxes.count(); i ++) {
+            glm::vec3 center(boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i]);
+            glm::vec3 extent(boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i]);
+            if (frustum.boxVisible(center, extent)) {
+                visible.push_back(static_cast<uint32_t>(i));
+            }
+        }
+        scalarVisible += visible.size();
+    }
+    double scalarMilliseconds = millisecondsSince(start) / frames;
+
+    printf("instances %zu  frames %u  SIMD width %u\n", instances, frames, SIMD_WIDTH);
+    printf("  world boxes  %9.3f ms (once per transform change)\n", buildMilliseconds);
+    printf("  cullBoxes    %9.3f ms/frame  visible %.1f%%\n", simdMilliseconds, 100.0 * simdVisible / (double(instances) * frames));
+    printf("  scalar       %9.3f ms/frame  visible %.1f%%\n", scalarMilliseconds, 100.0 * scalarVisible / (double(instances) * frames));
+    if (simdVisible != scalarVisible) {
+        printf("  MISMATCH: SIMD and scalar paths disagree\n");
+        return 1;
+    }
+    return 0;
+}
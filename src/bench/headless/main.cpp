@@ -0,0 +1,212 @@
+/*
+ * lab1_model without a display: the same model, shader and draw path rendered into an offscreen
+ * framebuffer for a fixed number of frames, results printed as JSON for regression tracking
+ * usage: bench_headless [frames] [--instances N] [--size WxH] [--model path] [--warmup N] [--out file.json]
+ * GLFW runs on its null platform with an OSMesa context (Mesa llvmpipe, no GPU or X server needed);
+ * without libOSMesa it falls back to a hidden window on the default platform (e.g. under Xvfb)
+ * every frame ends in glFinish, so frame times are what the driver took and not just the submission
+*/
+#include "header.h"
+#include "../bench_util.h"
+#include "offscreen.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+std::string jsonString(const std::string& text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+        }
+        quoted += static_cast<unsigned char>(c) < 0x20 ? ' ' : c;
+    }
+    return quoted + '"';
+}
+
+int main(int argc, char** argv) {
+    unsigned frames = 300, warmup = 10;
+    int instanceCount = 1, width = 1200, height = 900;
+    std::string modelPath = FileSystem::getPath("resource/model/creeper/Creeper.obj");
+    std::string outPath;
+    for (int i = 1; i < argc; i ++) {
+        std::string arg = argv[i];
+        if (arg == "--instances" && i + 1 < argc) {
+            instanceCount = std::max(1, std::atoi(argv[++ i]));
+        } else if (arg == "--size" && i + 1 < argc) {
+            if (std::sscanf(argv[++ i], "%dx%d", &width, &height) != 2 || width < 1 || height < 1) {
+                std::cerr << "ERROR::HEADLESS: --size expects WxH, e.g. 1200x900\n";
+                return -1;
+            }
+        } else if (arg == "--model" && i + 1 < argc) {
+            modelPath = argv[++ i];
+        } else if (arg == "--warmup" && i + 1 < argc) {
+            warmup = std::max(0, std::atoi(argv[++ i]));
+        } else if (arg == "--out" && i + 1 < argc) {
+            outPath = argv[++ i];
+        } else {
+            frames = std::max(1, std::atoi(arg.c_str()));
+        }
+    }
+
+    TraceRecorder::global().setThreadName("main");
+    glfwSetErrorCallback(error_callback);
+    const char* backend = "";
+    GLFWwindow* window = createHeadlessContext(&backend);
+    if (!window) {
+        return -1;
+    }
+
+    int exitCode = 0;
+    {
+        OffscreenTarget target;
+        if (!target.create(width, height)) {
+            std::cerr << "ERROR::HEADLESS: offscreen framebuffer incomplete\n";
+            glfwTerminate();
+            return -1;
+        }
+        glEnable(GL_DEPTH_TEST);
+
+        Shader shader(FileSystem::getPath("src/lab1/model/model.vs").c_str(), FileSystem::getPath("src/lab1/model/model.fs").c_str());
+
+        // textures load synchronously, so the load time covers everything the first frame needs
+        auto loadStart = std::chrono::steady_clock::now();
+        Model ourModel(modelPath);
+        glFinish();
+        double loadMilliseconds = millisecondsSince(loadStart);
+        ModelInstance ourInstances(ourModel);
+
+        Light light({
+            {10.0f, 30.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, 0.2f, 5.0f
+        });
+        // a larger grid needs the camera further out and looking down to see it
+        int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(instanceCount))));
+        float instanceSpacing = 3.0f;
+        Camera camera = instanceCount > 1
+            ? Camera(glm::vec3(0.0f, side * instanceSpacing * 0.5f, side * instanceSpacing), glm::vec3(0.0f, 1.0f, 0.0f), YAW, -30.0f)
+            : Camera(glm::vec3(0.0f, 0.0f, 3.0f));
+        camera.aspect = (float) width / height;
+        // the grid is uploaded once and turns as a whole through the model matrix, like the single model
+        if (instanceCount > 1) {
+            ourInstances.transforms.resize(instanceCount);
+            for (int i{}; i < instanceCount; i ++) {
+                glm::vec3 offset((i % side - side / 2) * instanceSpacing, 0.0f, (i / side - side / 2) * instanceSpacing);
+                ourInstances.transforms[i] = glm::translate(glm::mat4(1.0f), offset);
+            }
+            ourInstances.upload();
+        }
+
+        std::vector<double> frameMilliseconds;
+        frameMilliseconds.reserve(frames);
+        RenderStats frameStats;
+        double firstFrameMilliseconds = 0.0;
+        auto runStart = std::chrono::steady_clock::now();
+        for (unsigned frame{}; frame < warmup + frames; frame ++) {
+            TRACE_SCOPE("frame");
+            auto frameStart = std::chrono::steady_clock::now();
+            renderStats.reset();
+            glClearColor(0.2f, 0.2f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            // one full turn of the model and the light over the measured frames, the same every run
+            float t = static_cast<float>(frame) / frames;
+            shader.use();
+            glm::mat4 model = glm::rotate(glm::mat4(1.0f), glm::radians(360.0f * t), glm::vec3(0.0f, 1.0f, 0.0f));
+            auto view = camera.getViewMatrix();
+            auto projection = camera.getProjectionMatrix();
+            glm::mat4 normal = glm::inverse(glm::transpose(model));
+            shader.setMat4("model", glm::value_ptr(model));
+            shader.setMat4("view", glm::value_ptr(view));
+            shader.setMat4("projection", glm::value_ptr(projection));
+            shader.setMat4("NormalMatrix", glm::value_ptr(normal));
+            light.pos = glm::vec3(10.0f * cos(6.2831853f * t), 10.0f, 10.0f * sin(6.2831853f * t));
+            light.render(shader);
+            shader.setVec3("camPos", camera.position);
+
+            if (instanceCount > 1) {
+                // culled in the grid's space, so the boxes from the one upload stay valid
+                ourInstances.Draw(shader, Frustum::fromMatrix(projection * view * model));
+            } else {
+                ourModel.Draw(shader, camera, model);
+            }
+
+            {
+                TRACE_SCOPE("glFinish");
+                glFinish();
+            }
+            glfwPollEvents();
+            double milliseconds = millisecondsSince(frameStart);
+            if (frame == 0) {
+                firstFrameMilliseconds = milliseconds;
+            }
+            if (frame == warmup) {
+                runStart = frameStart;
+            }
+            if (frame >= warmup) {
+                frameMilliseconds.push_back(milliseconds);
+                frameStats = renderStats;
+            }
+        }
+        double runMilliseconds = millisecondsSince(runStart);
+
+        std::vector<double> sorted = frameMilliseconds;
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0.0;
+        for (double milliseconds : sorted) {
+            total += milliseconds;
+        }
+        GLenum error = glGetError();
+        if (error != GL_NO_ERROR) {
+            std::cerr << "ERROR::HEADLESS: GL error 0x" << std::hex << error << std::dec << '\n';
+            exitCode = 1;
+        }
+
+        auto renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+        std::string backendJson = jsonString(backend), rendererJson = jsonString(renderer ? renderer : "unknown"), modelJson = jsonString(modelPath);
+        // printed straight into each sink, the quoted strings have no length limit
+        auto writeJson = [&](FILE* out) {
+            return std::fprintf(out,
+                "{\n"
+                "  \"backend\": %s,\n"
+                "  \"renderer\": %s,\n"
+                "  \"model\": %s,\n"
+                "  \"width\": %d,\n"
+                "  \"height\": %d,\n"
+                "  \"instances\": %d,\n"
+                "  \"warmupFrames\": %u,\n"
+                "  \"frames\": %u,\n"
+                "  \"loadMs\": %.3f,\n"
+                "  \"firstFrameMs\": %.3f,\n"
+                "  \"frameMs\": {\"mean\": %.3f, \"min\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f},\n"
+                "  \"fps\": %.2f,\n"
+                "  \"drawCallsPerFrame\": %llu,\n"
+                "  \"trianglesPerFrame\": %llu,\n"
+                "  \"glError\": %u\n"
+                "}\n",
+                backendJson.c_str(), rendererJson.c_str(), modelJson.c_str(), width, height, instanceCount, warmup, frames, loadMilliseconds, firstFrameMilliseconds,
+                total / sorted.size(), sorted.front(), percentile(sorted, 50.0), percentile(sorted, 90.0), percentile(sorted, 95.0),
+                percentile(sorted, 99.0), sorted.back(), runMilliseconds > 0.0 ? frames * 1000.0 / runMilliseconds : 0.0,
+                static_cast<unsigned long long>(frameStats.drawCalls), static_cast<unsigned long long>(frameStats.triangles), error) >= 0;
+        };
+        writeJson(stdout);
+        if (!outPath.empty()) {
+            FILE* file = std::fopen(outPath.c_str(), "w");
+            bool written = file && writeJson(file);
+            if (file && std::fclose(file) != 0) {
+                written = false;
+            }
+            if (!written) {
+                std::cerr << "ERROR::HEADLESS: failed to write " << outPath << '\n';
+                exitCode = 1;
+            }
+        }
+    }
+
+    glfwTerminate();
+    return exitCode;
+}
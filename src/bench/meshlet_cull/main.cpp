@@ -0,0 +1,152 @@
+/*
+ * meshlet culling on a dense closed mesh: cullMeshlets (cone + sphere, SIMD_WIDTH lanes) vs a scalar
+ * backface test of every triangle
+ * usage: bench_meshlet_cull [segments] [--frames N]
+ * the mesh is a bumpy sphere of segments x segments / 2 quads (default 512, 262k triangles) in
+ * vertex cache order, as Model builds meshlets; the camera orbits close enough to clip its edges
+ * every culled meshlet inside the frustum is checked triangle by triangle and a front-facing one
+ * fails the run, so the cones stay conservative
+*/
+#include "header.h"
+#include "../bench_util.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+// lattice around a sphere with a few percent of bumps, counter-clockwise faces looking from outside
+void bumpySphere(unsigned segments, std::vector<Vertex>& vertices, std::vector<unsigned>& indices) {
+    unsigned rings = std::max(segments / 2, 2u);
+    vertices.clear();
+    indices.clear();
+    for (unsigned r{}; r <= rings; r ++) {
+        float theta = 3.1415927f * r / rings;
+        for (unsigned s{}; s <= segments; s ++) {
+            float phi = 6.2831853f * s / segments;
+            glm::vec3 direction(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+            float radius = 1.0f + 0.04f * std::sin(7.0f * theta) * std::cos(9.0f * phi);
+            vertices.push_back({direction * radius, direction, glm::vec2(float(s) / segments, float(r) / rings)});
+        }
+    }
+    for (unsigned r{}; r < rings; r ++) {
+        for (unsigned s{}; s < segments; s ++) {
+            unsigned a = r * (segments + 1) + s, b = a + segments + 1;
+            for (auto triangle : {glm::uvec3(a, b, a + 1), glm::uvec3(a + 1, b, b + 1)}) {
+                glm::vec3 p0 = vertices[triangle.x].Position, p1 = vertices[triangle.y].Position, p2 = vertices[triangle.z].Position;
+                // the pole rows are degenerate, drop them; orient the rest away from the center
+                glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                if (glm::length(normal) < 1e-9f) {
+                    continue;
+                }
+                if (glm::dot(normal, p0 + p1 + p2) < 0.0f) {
+                    std::swap(triangle.y, triangle.z);
+                }
+                indices.insert(indices.end(), {triangle.x, triangle.y, triangle.z});
+            }
+        }
+    }
+}
+
+// the triangle turns its back on eye (or is seen edge-on)
+bool backfacing(const std::vector<Vertex>& vertices, const unsigned* triangle, const glm::vec3& eye) {
+    glm::vec3 a = vertices[triangle[0]].Position, b = vertices[triangle[1]].Position, c = vertices[triangle[2]].Position;
+    return glm::dot(glm::cross(b - a, c - a), a - eye) >= 0.0f;
+}
+
+int main(int argc, char** argv) {
+    unsigned segments = 512, frames = 100;
+    for (int i = 1; i < argc; i ++) {
+        std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc) {
+            frames = std::max(1, std::atoi(argv[++ i]));
+        } else {
+            segments = std::max(4, std::atoi(arg.c_str()));
+        }
+    }
+
+    std::vector<Vertex> vertices;
+    std::vector<unsigned> indices;
+    bumpySphere(segments, vertices, indices);
+    optimizeVertexCache(indices, vertices.size());
+    MeshletSet meshlets;
+    auto start = std::chrono::steady_clock::now();
+    buildMeshlets(vertices.data(), indices.data(), indices.size(), meshlets);
+    double buildMilliseconds = millisecondsSince(start);
+    size_t triangleCount = indices.size() / 3;
+
+    // orbit at 2.5 radii, bobbing up and down; the sphere overfills the vertical field of view
+    Camera camera(glm::vec3(0.0f));
+    camera.aspect = 16.0f / 9.0f;
+    std::vector<Frustum> frustums(frames);
+    std::vector<glm::vec3> eyes(frames);
+    for (unsigned f{}; f < frames; f ++) {
+        float angle = 6.2831853f * f / frames;
+        camera.position = glm::vec3(std::cos(angle), 0.6f * std::sin(3.0f * angle), std::sin(angle)) * 2.5f;
+        glm::vec3 front = glm::normalize(-camera.position);
+        camera.yaw = glm::degrees(std::atan2(front.z, front.x));
+        camera.pitch = glm::degrees(std::asin(front.y));
+        camera.processMouseMovement(0.0f, 0.0f);
+        frustums[f] = camera.frustum();
+        eyes[f] = camera.position;
+    }
+
+    std::vector<uint32_t> visible;
+    size_t visibleMeshlets{}, visibleTriangles{};
+    start = std::chrono::steady_clock::now();
+    for (unsigned f{}; f < frames; f ++) {
+        cullMeshlets(meshlets, frustums[f], eyes[f], visible);
+        visibleMeshlets += visible.size();
+        for (auto m : visible) {
+            visibleTriangles += meshlets.indexCount[m] / 3;
+        }
+    }
+    double simdMilliseconds = millisecondsSince(start) / frames;
+
+    size_t backfacingTriangles{};
+    start = std::chrono::steady_clock::now();
+    for (unsigned f{}; f < frames; f ++) {
+        for (size_t t{}; t < triangleCount; t ++) {
+            backfacingTriangles += backfacing(vertices, &indices[t * 3], eyes[f]);
+        }
+    }
+    double scalarMilliseconds = millisecondsSince(start) / frames;
+
+    // untimed: split the culled meshlets into off-screen and backfacing ones, the latter must be
+    // backfacing in every triangle; spheres grazing a plane count as off-screen, the lanes may round differently
+    size_t coneTriangles{}, falseCulls{};
+    std::vector<bool> shown(meshlets.count());
+    for (unsigned f{}; f < frames; f ++) {
+        cullMeshlets(meshlets, frustums[f], eyes[f], visible);
+        std::fill(shown.begin(), shown.end(), false);
+        for (auto m : visible) {
+            shown[m] = true;
+        }
+        for (size_t m{}; m < meshlets.count(); m ++) {
+            glm::vec3 center(meshlets.centerX[m], meshlets.centerY[m], meshlets.centerZ[m]);
+            if (shown[m] || !frustums[f].sphereVisible(center, meshlets.radius[m] - 1e-4f)) {
+                continue;
+            }
+            coneTriangles += meshlets.indexCount[m] / 3;
+            for (uint32_t i{}; i < meshlets.indexCount[m]; i += 3) {
+                if (!backfacing(vertices, &indices[meshlets.firstIndex[m] + i], eyes[f])) {
+                    falseCulls ++;
+                    break;
+                }
+            }
+        }
+    }
+
+    double frameTriangles = double(triangleCount) * frames;
+    printf("triangles %zu  meshlets %zu (%.1f triangles each)  frames %u  SIMD width %u\n", triangleCount, meshlets.count(),
+        double(triangleCount) / meshlets.count(), frames, SIMD_WIDTH);
+    printf("  buildMeshlets %9.3f ms (once per load)\n", buildMilliseconds);
+    printf("  cullMeshlets  %9.3f ms/frame  culled %.1f%% of meshlets, %.1f%% of triangles (%.1f%% as backfacing)\n", simdMilliseconds,
+        100.0 - 100.0 * visibleMeshlets / (double(meshlets.count()) * frames), 100.0 - 100.0 * visibleTriangles / frameTriangles,
+        100.0 * coneTriangles / frameTriangles);
+    printf("  scalar        %9.3f ms/frame  backfacing %.1f%% of triangles\n", scalarMilliseconds, 100.0 * backfacingTriangles / frameTriangles);
+    if (falseCulls) {
+        printf("self-check FAILED: %zu culled meshlets have front-facing triangles inside the frustum\n", falseCulls);
+        return 1;
+    }
+    return 0;
+}
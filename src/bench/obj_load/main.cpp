@@ -0,0 +1,128 @@
+/*
+ * OBJ load throughput: Assimp importer vs loadObjFast
+ * usage: bench_obj_load [file.obj ...] [--repeat N]
+ * defaults to the bundled Creeper; point it at multi-GB scans for meaningful numbers
+ * also reports heap allocations and peak RSS (Linux) of each path
+*/
+#include "header.h"
+#include "../bench_util.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <new>
+
+// count every heap allocation made by the loaders under test
+std::atomic<size_t> allocationCount{0};
+
+// kept out of line: once inlined into callers GCC pairs the malloc/free with new/delete
+// and reports -Wmismatched-new-delete at every container in the file
+#if defined(__GNUC__)
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+BENCH_NOINLINE void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+BENCH_NOINLINE void* operator new[](size_t size) { return operator new(size); }
+BENCH_NOINLINE void operator delete(void* p) noexcept { std::free(p); }
+BENCH_NOINLINE void operator delete(void* p, size_t) noexcept { std::free(p); }
+BENCH_NOINLINE void operator delete[](void* p) noexcept { std::free(p); }
+BENCH_NOINLINE void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+struct BenchResult {
+    double seconds;
+    size_t meshes, vertices, indices;
+    size_t allocations, peakKB;
+};
+
+template <typename F>
+BenchResult measure(unsigned repeat, F&& load) {
+    BenchResult best{1e30, 0, 0, 0, 0, 0};
+    for (unsigned r{}; r < repeat; r ++) {
+        resetPeakResident();
+        size_t allocations = allocationCount.load();
+        auto start = std::chrono::steady_clock::now();
+        BenchResult result = load();
+        result.seconds = millisecondsSince(start) / 1000.0;
+        result.allocations = allocationCount.load() - allocations;
+        result.peakKB = statusKB("VmHWM:");
+        if (result.seconds < best.seconds) {
+            best = result;
+        }
+    }
+    return best;
+}
+
+void report(const char* name, const BenchResult& result, double megabytes) {
+    printf("  %-8s %9.3f ms  %9.1f MB/s  meshes %zu  vertices %zu  indices %zu  allocations %zu  peak RSS %.1f MB\n",
+        name, result.seconds * 1000.0, megabytes / result.seconds, result.meshes, result.vertices, result.indices,
+        result.allocations, result.peakKB / 1024.0);
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> files;
+    unsigned repeat = 3;
+    for (int i = 1; i < argc; i ++) {
+        std::string arg = argv[i];
+        if (arg == "--repeat" && i + 1 < argc) {
+            repeat = std::max(1, std::atoi(argv[++ i]));
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (files.empty()) {
+        files.push_back(FileSystem::getPath("resource/model/creeper/Creeper.obj"));
+    }
+
+    for (auto& file : files) {
+        std::error_code ec;
+        auto bytes = std::filesystem::file_size(file, ec);
+        if (ec) {
+            printf("%s: cannot stat file\n", file.c_str());
+            continue;
+        }
+        double megabytes = bytes / (1024.0 * 1024.0);
+        printf("%s (%.1f MB, best of %u)\n", file.c_str(), megabytes, repeat);
+
+        auto assimp = measure(repeat, [&file] {
+            Assimp::Importer importer;
+            const aiScene* scene = importer.ReadFile(file, MODEL_IMPORT_FLAGS);
+            BenchResult result{0, 0, 0, 0, 0, 0};
+            if (scene) {
+                result.meshes = scene->mNumMeshes;
+                for (unsigned i{}; i < scene->mNumMeshes; i ++) {
+                    result.vertices += scene->mMeshes[i]->mNumVertices;
+                    result.indices += scene->mMeshes[i]->mNumFaces * 3;
+                }
+            }
+            return result;
+        });
+        report("assimp", assimp, megabytes);
+
+        auto fastLoad = [&file](bool parallel) {
+            std::vector<MeshData> meshes;
+            loadObjFast(file, meshes, parallel);
+            BenchResult result{0, meshes.size(), 0, 0, 0, 0};
+            for (auto& mesh : meshes) {
+                result.vertices += mesh.vertices.size();
+                result.indices += mesh.indices.size();
+            }
+            return result;
+        };
+        auto serial = measure(repeat, [&fastLoad] { return fastLoad(false); });
+        report("fast x1", serial, megabytes);
+        auto fast = measure(repeat, [&fastLoad] { return fastLoad(true); });
+        report("fast", fast, megabytes);
+        printf("  speedup  %.2fx over assimp, %.2fx over one thread\n", assimp.seconds / fast.seconds, serial.seconds / fast.seconds);
+    }
+    return 0;
+}
@@ -0,0 +1,134 @@
+/*
+ * software occlusion culling on a dense city block: frustum culling alone vs frustum + OcclusionBuffer
+ * usage: bench_occlusion_cull [buildings per side] [--occluders N] [--frames N]
+ * buildings are boxes of random height on a grid (default 300 x 300 = 90k), the camera walks down
+ * a street at eye level; the nearest N frustum-visible buildings (default 64) are the occluders
+ * a self-check against a wall runs first and fails the run if the buffer misjudges it
+*/
+#include "header.h"
+#include "../bench_util.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+// unit cube around the origin, counter-clockwise faces looking from outside
+void unitCube(std::vector<Vertex>& vertices, std::vector<unsigned>& indices) {
+    vertices.clear();
+    for (int k{}; k < 8; k ++) {
+        vertices.push_back({glm::vec3(k & 1 ? 0.5f : -0.5f, k & 2 ? 0.5f : -0.5f, k & 4 ? 0.5f : -0.5f), glm::vec3(0.0f), glm::vec2(0.0f)});
+    }
+    indices = {
+        0, 2, 3, 0, 3, 1,  4, 5, 7, 4, 7, 6,  // -z, +z
+        0, 4, 6, 0, 6, 2,  1, 3, 7, 1, 7, 5,  // -x, +x
+        0, 1, 5, 0, 5, 4,  2, 6, 7, 2, 7, 3,  // -y, +y
+    };
+}
+
+bool selfCheck(const std::vector<Vertex>& cube, const std::vector<unsigned>& indices) {
+    OcclusionBuffer occlusion;
+    Camera camera(glm::vec3(0.0f));
+    camera.aspect = float(occlusion.width()) / occlusion.height();
+    occlusion.clear(camera.getProjectionMatrix() * camera.getViewMatrix());
+    // a 40 x 40 wall 10 in front of the camera hides everything straight ahead behind it
+    glm::mat4 wall = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -10.0f)), glm::vec3(40.0f, 40.0f, 1.0f));
+    occlusion.addOccluder(cube.data(), cube.size(), indices.data(), indices.size(), wall);
+    occlusion.rasterize();
+    bool behind = occlusion.boxVisible(glm::vec3(0.0f, 0.0f, -20.0f), glm::vec3(1.0f));
+    bool before = occlusion.boxVisible(glm::vec3(0.0f, 0.0f, -5.0f), glm::vec3(1.0f));
+    bool straddling = occlusion.boxVisible(glm::vec3(0.0f, 0.0f, -10.0f), glm::vec3(1.0f, 1.0f, 2.0f));
+    printf("self-check: behind wall %s, in front %s, through wall %s\n",
+        behind ? "visible" : "occluded", before ? "visible" : "occluded", straddling ? "visible" : "occluded");
+    return !behind && before && straddling;
+}
+
+int main(int argc, char** argv) {
+    int side = 300;
+    size_t occluderCount = 64;
+    unsigned frames = 50;
+    for (int i = 1; i < argc; i ++) {
+        std::string arg = argv[i];
+        if (arg == "--occluders" && i + 1 < argc) {
+            occluderCount = std::max(0, std::atoi(argv[++ i]));
+        } else if (arg == "--frames" && i + 1 < argc) {
+            frames = std::max(1, std::atoi(argv[++ i]));
+        } else {
+            side = std::max(1, std::atoi(arg.c_str()));
+        }
+    }
+
+    std::vector<Vertex> cube;
+    std::vector<unsigned> cubeIndices;
+    unitCube(cube, cubeIndices);
+    if (!selfCheck(cube, cubeIndices)) {
+        printf("self-check FAILED\n");
+        return 1;
+    }
+
+    // 4 x 4 blocks on a 6 m grid leave 2 m streets
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> height(4.0f, 30.0f);
+    std::vector<glm::mat4> transforms;
+    BoxSet boxes;
+    for (int z{}; z < side; z ++) {
+        for (int x{}; x < side; x ++) {
+            float h = height(random);
+            glm::vec3 center((x - side / 2) * 6.0f, h * 0.5f, (z - side / 2) * 6.0f);
+            transforms.push_back(glm::scale(glm::translate(glm::mat4(1.0f), center), glm::vec3(4.0f, h, 4.0f)));
+            boxes.push(glm::vec3(0.0f), glm::vec3(0.5f), transforms.back());
+        }
+    }
+
+    OcclusionBuffer occlusion;
+    Camera camera(glm::vec3(3.0f, 1.7f, 0.0f));
+    camera.aspect = 16.0f / 9.0f;
+    camera.farPlane = 1000.0f;
+    std::vector<uint32_t> visible;
+    std::vector<std::pair<float, uint32_t>> nearest;
+    size_t frustumVisible{}, occlusionVisible{}, triangles{};
+    double frustumMilliseconds{}, occluderMilliseconds{}, rasterMilliseconds{}, testMilliseconds{};
+    for (unsigned f{}; f < frames; f ++) {
+        // along the street, looking a little to either side
+        camera.position.z = side * 2.0f - f * (side * 4.0f / frames);
+        camera.yaw = -90.0f + 20.0f * std::sin(f * 0.3f);
+        camera.processMouseMovement(0.0f, 0.0f);
+        occlusion.clear(camera.getProjectionMatrix() * camera.getViewMatrix());
+
+        auto start = std::chrono::steady_clock::now();
+        cullBoxes(boxes, camera.frustum(), visible);
+        frustumMilliseconds += millisecondsSince(start);
+        frustumVisible += visible.size();
+
+        start = std::chrono::steady_clock::now();
+        nearest.clear();
+        for (auto i : visible) {
+            nearest.emplace_back(occlusion.viewDepth(glm::vec3(boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i])), i);
+        }
+        size_t count = std::min(occluderCount, nearest.size());
+        std::partial_sort(nearest.begin(), nearest.begin() + count, nearest.end());
+        for (size_t k{}; k < count; k ++) {
+            occlusion.addOccluder(cube.data(), cube.size(), cubeIndices.data(), cubeIndices.size(), transforms[nearest[k].second]);
+        }
+        occluderMilliseconds += millisecondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        occlusion.rasterize();
+        rasterMilliseconds += millisecondsSince(start);
+        triangles += occlusion.rasterizedTriangles();
+
+        start = std::chrono::steady_clock::now();
+        occlusion.filterVisible(boxes, visible);
+        testMilliseconds += millisecondsSince(start);
+        occlusionVisible += visible.size();
+    }
+
+    printf("buildings %zu  occluders %zu  frames %u  buffer %dx%d  SIMD width %u  threads %u\n", boxes.count(), occluderCount,
+        frames, occlusion.width(), occlusion.height(), SIMD_WIDTH, ThreadPool::global().size() + 1);
+    printf("  frustum      %9.3f ms/frame  %9.1f draws\n", frustumMilliseconds / frames, double(frustumVisible) / frames);
+    printf("  occluders    %9.3f ms/frame  %9.1f triangles\n", occluderMilliseconds / frames, double(triangles) / frames);
+    printf("  rasterize    %9.3f ms/frame\n", rasterMilliseconds / frames);
+    printf("  box tests    %9.3f ms/frame  %9.1f draws  (%.1fx fewer)\n", testMilliseconds / frames, double(occlusionVisible) / frames,
+        occlusionVisible ? double(frustumVisible) / occlusionVisible : 0.0);
+    return 0;
+}
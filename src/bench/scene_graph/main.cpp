@@ -0,0 +1,115 @@
+/*
+ * SceneGraph update cost: full rebuild vs dirty subtrees, on a generated hierarchy
+ * usage: bench_scene_graph [nodes] [--fanout N] [--frames N]
+ * nodes (default 1M) form a random tree of up to N children per node (default 8), built depth-first;
+ * each frame either animates a fraction of random nodes or one node near the root
+ * results are checked against a plain serial loop over every node, which is also timed
+*/
+#include "header.h"
+#include "../bench_util.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+// depth-first: each node gets a random number of children until the budget runs out
+void buildTree(SceneGraph& graph, size_t nodeCount, unsigned fanout, std::mt19937& random) {
+    std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+    std::uniform_int_distribution<unsigned> children(1, fanout);
+    std::vector<std::pair<uint32_t, unsigned>> open; // node, children still to add
+    while (graph.size() < nodeCount) {
+        uint32_t parent = SCENE_NO_PARENT;
+        while (!open.empty() && open.back().second == 0) {
+            open.pop_back();
+        }
+        if (!open.empty()) {
+            parent = open.back().first;
+            open.back().second --;
+        }
+        glm::mat4 local = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(offset(random), offset(random), offset(random))),
+            offset(random), glm::vec3(0.0f, 1.0f, 0.0f));
+        uint32_t node = graph.addNode(parent, local);
+        // shallow enough that the tree stays bushy: leaves once the stack is deep
+        open.emplace_back(node, open.size() < 12 ? children(random) : 0);
+    }
+}
+
+// plain serial pass over every node, the baseline for a full update
+std::vector<glm::mat4> referenceWorlds(const SceneGraph& graph) {
+    std::vector<glm::mat4> reference(graph.size());
+    for (uint32_t n{}; n < graph.size(); n ++) {
+        uint32_t parent = graph.parent(n);
+        reference[n] = parent == SCENE_NO_PARENT ? graph.local(n) : reference[parent] * graph.local(n);
+    }
+    return reference;
+}
+
+bool matches(const SceneGraph& graph, const std::vector<glm::mat4>& reference) {
+    for (uint32_t n{}; n < graph.size(); n ++) {
+        glm::mat4 difference = reference[n] - graph.world(n);
+        for (int c{}; c < 4; c ++) {
+            if (glm::length(difference[c]) > 1e-3f * (1.0f + glm::length(reference[n][c]))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    size_t nodeCount = 1000000;
+    unsigned fanout = 8, frames = 20;
+    for (int i = 1; i < argc; i ++) {
+        std::string arg = argv[i];
+        if (arg == "--fanout" && i + 1 < argc) {
+            fanout = std::max(1, std::atoi(argv[++ i]));
+        } else if (arg == "--frames" && i + 1 < argc) {
+            frames = std::max(1, std::atoi(argv[++ i]));
+        } else {
+            nodeCount = std::max(1, std::atoi(arg.c_str()));
+        }
+    }
+
+    std::mt19937 random(3);
+    SceneGraph graph;
+    auto start = std::chrono::steady_clock::now();
+    buildTree(graph, nodeCount, fanout, random);
+    printf("nodes %zu  fanout %u  threads %u  build %.1f ms\n", graph.size(), fanout, ThreadPool::global().size() + 1, millisecondsSince(start));
+
+    std::uniform_int_distribution<uint32_t> pick(0, static_cast<uint32_t>(graph.size() - 1));
+    glm::mat4 spin = glm::rotate(glm::mat4(1.0f), 0.01f, glm::vec3(0.0f, 1.0f, 0.0f));
+    // each frame: flag some nodes, then time update()
+    auto run = [&](const char* name, auto&& animate) {
+        size_t updated{};
+        double milliseconds{};
+        for (unsigned f{}; f < frames; f ++) {
+            animate();
+            start = std::chrono::steady_clock::now();
+            updated += graph.update();
+            milliseconds += millisecondsSince(start);
+        }
+        printf("  %-14s %9.3f ms/frame  %11.1f nodes updated\n", name, milliseconds / frames, double(updated) / frames);
+    };
+    auto animate = [&](uint32_t node) { graph.setLocal(node, graph.local(node) * spin); };
+    run("whole tree", [&] { animate(0); });
+    run("near root", [&] { animate(1); });
+    run("1% random", [&] {
+        for (size_t d{}; d < graph.size() / 100; d ++) {
+            animate(pick(random));
+        }
+    });
+    run("100 random", [&] {
+        for (int d{}; d < 100; d ++) {
+            animate(pick(random));
+        }
+    });
+    run("clean", [] {});
+
+    start = std::chrono::steady_clock::now();
+    auto reference = referenceWorlds(graph);
+    printf("  %-14s %9.3f ms/frame  %11zu nodes updated\n", "serial loop", millisecondsSince(start), graph.size());
+    bool same = matches(graph, reference);
+    printf("  world matrices %s the serial loop\n", same ? "match" : "DO NOT match");
+    return same ? 0 : 1;
+}
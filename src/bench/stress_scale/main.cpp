@@ -0,0 +1,439 @@
+/*
+ * scaling curves of Model, Mesh and the render loop on generated stress scenes (stress_scene.h)
+ * usage: bench_stress_scale [--sweep meshes|vertices|materials|textures|instances|all] [--points N]
+ *                           [--frames N] [--dir path] [--out file.json] [--no-render]
+ *        bench_stress_scale --stream [--tiles N] [--budget-tiles N] [--frames N] [--dir path] [--out file.json]
+ * each sweep multiplies one count by 4 per point from 1 (vertices: from 256) while the others keep
+ * their StressSceneConfig defaults; per point it reports the OBJ import (cold, writes the mesh cache),
+ * the mesh cache load (warm), peak RSS of the import, the GL upload, resident memory afterwards
+ * and the frame-time percentiles of an offscreen render (offscreen.h), so scaling cliffs show as
+ * a jump between neighbouring rows; --no-render or a machine without GL keeps the CPU columns only
+ * --stream lays out N small scenes as tiles (default 64) and flies the camera across them and back
+ * through ModelStreamer, with both budgets set to what --budget-tiles tiles take (default 16); it
+ * reports loads, evictions and peak usage, and fails if a budget is exceeded after an update or an
+ * eviction takes a model wanted more recently than one that stays resident
+*/
+#include "header.h"
+#include "../bench_util.h"
+#include "model_streamer.h"
+#include "offscreen.h"
+#include "stress_scene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+struct SweepPoint {
+    const char* sweep;
+    unsigned value;
+    StressSceneStats scene;
+    double generateMs = 0.0, coldMs = 0.0, warmMs = 0.0, uploadMs = 0.0;
+    size_t geometryBytes = 0;           // vertices + indices as loaded
+    size_t importPeakKB = 0, residentKB = 0;
+    bool rendered = false;
+    double frameP50 = 0.0, frameP95 = 0.0, frameP99 = 0.0, frameMax = 0.0;
+    uint64_t drawCalls = 0, triangles = 0;
+};
+
+unsigned& sweptCount(StressSceneConfig& config, const std::string& sweep) {
+    if (sweep == "meshes") {
+        return config.meshes;
+    } else if (sweep == "vertices") {
+        return config.verticesPerMesh;
+    } else if (sweep == "materials") {
+        return config.materials;
+    } else if (sweep == "textures") {
+        return config.textures;
+    }
+    return config.instances;
+}
+
+// frames of the whole scene through ModelInstance, the camera backed off to see every copy
+void renderPoint(SweepPoint& point, Model& model, Shader& shader, const StressSceneConfig& config, unsigned frames, int width, int height) {
+    ModelInstance instances(model);
+    instances.transforms = stressSceneInstances(config);
+    instances.upload();
+    unsigned side = static_cast<unsigned>(std::ceil(std::sqrt(static_cast<double>(instances.transforms.size()))));
+    float distance = stressSceneExtent(config) * (2.5f * side + 2.0f);
+    Camera camera(glm::vec3(0.0f, distance * 0.5f, distance), glm::vec3(0.0f, 1.0f, 0.0f), YAW, -26.5f);
+    camera.aspect = (float) width / height;
+    camera.farPlane = std::max(camera.farPlane, distance * 3.0f);
+    Light light({
+        {10.0f, 30.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, 0.2f, 5.0f
+    });
+
+    std::vector<double> frameMilliseconds;
+    for (unsigned frame{}; frame < frames + 2; frame ++) {
+        auto frameStart = std::chrono::steady_clock::now();
+        renderStats.reset();
+        glClearColor(0.2f, 0.2f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        shader.use();
+        glm::mat4 identity(1.0f);
+        auto view = camera.getViewMatrix();
+        auto projection = camera.getProjectionMatrix();
+        shader.setMat4("model", glm::value_ptr(identity));
+        shader.setMat4("view", glm::value_ptr(view));
+        shader.setMat4("projection", glm::value_ptr(projection));
+        shader.setMat4("NormalMatrix", glm::value_ptr(identity));
+        light.render(shader);
+        shader.setVec3("camPos", camera.position);
+        instances.Draw(shader, camera.frustum());
+        glFinish();
+        // the first two frames pay for shader and texture residency, not for the scene size
+        if (frame >= 2) {
+            frameMilliseconds.push_back(millisecondsSince(frameStart));
+        }
+    }
+    std::sort(frameMilliseconds.begin(), frameMilliseconds.end());
+    point.rendered = true;
+    point.frameP50 = percentile(frameMilliseconds, 50.0);
+    point.frameP95 = percentile(frameMilliseconds, 95.0);
+    point.frameP99 = percentile(frameMilliseconds, 99.0);
+    point.frameMax = frameMilliseconds.back();
+    point.drawCalls = renderStats.drawCalls;
+    point.triangles = renderStats.triangles;
+}
+
+struct StreamRun {
+    unsigned tiles = 0, frames = 0;
+    size_t ramBudget = 0, vramBudget = 0;
+    double generateMs = 0.0;
+    size_t uploads = 0, evictions = 0, peakResident = 0, peakRam = 0, peakVram = 0;
+    size_t overBudgetFrames = 0, lruViolations = 0;
+    double frameP50 = 0.0, frameP99 = 0.0, frameMax = 0.0;
+};
+
+// streamed tiles under a camera flying over the middle row and back, checked after every update()
+bool runStream(StreamRun& run, const std::string& directory, unsigned budgetTiles, Shader& shader, int width, int height) {
+    StressSceneConfig tile;
+    tile.meshes = 8;
+    tile.verticesPerMesh = 1024;
+    tile.materials = 2;
+    tile.textures = 2;
+    tile.textureSize = 128;
+    tile.instances = run.tiles;
+    tile.bakeCaches = true; // every read is a mesh cache hit, like a prepared streaming build
+    std::vector<std::string> paths;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned t{}; t < run.tiles; t ++) {
+        tile.seed = t + 1;
+        StressSceneStats stats;
+        std::string tileDirectory = directory + "/stream/tile_" + std::to_string(t);
+        std::filesystem::remove_all(tileDirectory);
+        if (!writeStressScene(tileDirectory, tile, &stats)) {
+            return false;
+        }
+        paths.push_back(stats.path);
+    }
+    run.generateMs = millisecondsSince(start);
+
+    // budgets in tiles, sized the way ModelStreamer estimates a read and an upload
+    ModelData data;
+    if (!Model::readData(paths[0], ModelConfig{}, data)) {
+        std::cerr << "ERROR::STRESS_SCALE: failed to load " << paths[0] << '\n';
+        return false;
+    }
+    size_t tileRam{}, tileVram = size_t(tile.textures) * tile.textureSize * tile.textureSize * 3 * 4 / 3;
+    for (auto& mesh : data.meshes) {
+        tileRam += mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(unsigned);
+        tileVram += mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * (mesh.vertices.size() <= 65536 ? sizeof(uint16_t) : sizeof(unsigned));
+    }
+    auto transforms = stressSceneInstances(tile);
+    glm::vec3 extent(stressSceneExtent(tile));
+    unsigned side = static_cast<unsigned>(std::ceil(std::sqrt(static_cast<double>(run.tiles))));
+    float spacing = stressSceneExtent(tile) * 2.5f;
+    float span = (side + 1) * 0.5f * spacing;
+    StreamingConfig config;
+    config.ramBudget = run.ramBudget = tileRam * budgetTiles;
+    config.vramBudget = run.vramBudget = tileVram * budgetTiles;
+    // wanted up to about one tile spacing away (two in view), so the camera leaves unwanted
+    // residents behind and which of them goes first is down to the eviction order
+    config.minScreenFraction = Camera().screenFraction(glm::vec3(spacing, 0.0f, 0.0f), glm::length(extent));
+
+    ModelStreamer streamer(config);
+    for (unsigned t{}; t < run.tiles; t ++) {
+        streamer.add(paths[t], transforms[t], glm::vec3(0.0f), extent);
+    }
+    Light light({
+        {10.0f, 30.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, 0.2f, 5.0f
+    });
+
+    std::vector<bool> wasResident(run.tiles);
+    std::vector<double> frameMilliseconds;
+    for (unsigned frame{}; frame < run.frames; frame ++) {
+        auto frameStart = std::chrono::steady_clock::now();
+        // out along +x for the first half, back along -x, so evicted tiles are wanted again
+        float u = run.frames > 1 ? static_cast<float>(frame) / (run.frames - 1) : 0.0f;
+        bool out = u < 0.5f;
+        float x = -span + 2.0f * span * (out ? 2.0f * u : 2.0f - 2.0f * u);
+        Camera camera(glm::vec3(x, extent.x * 1.5f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), out ? 0.0f : 180.0f, -15.0f);
+        camera.aspect = (float) width / height;
+
+        streamer.update(camera, 1.0f / 60.0f);
+        AsyncTextureLoader::global().poll();
+        if (streamer.ramUsed() > config.ramBudget || streamer.vramUsed() > config.vramBudget) {
+            run.overBudgetFrames ++;
+        }
+        run.peakRam = std::max(run.peakRam, streamer.ramUsed());
+        run.peakVram = std::max(run.peakVram, streamer.vramUsed());
+        run.peakResident = std::max(run.peakResident, streamer.residentCount());
+        // least recently wanted first: nothing that stays may have been wanted longer ago than what went
+        uint64_t evictedLatest{}, keptOldest = ~uint64_t(0);
+        for (unsigned t{}; t < run.tiles; t ++) {
+            bool resident = streamer.model(t) != nullptr;
+            if (resident && !wasResident[t]) {
+                run.uploads ++;
+            } else if (!resident && wasResident[t]) {
+                run.evictions ++;
+                evictedLatest = std::max(evictedLatest, streamer.lastWanted(t));
+            } else if (resident) {
+                keptOldest = std::min(keptOldest, streamer.lastWanted(t));
+            }
+            wasResident[t] = resident;
+        }
+        if (evictedLatest > keptOldest) {
+            run.lruViolations ++;
+        }
+
+        glClearColor(0.2f, 0.2f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        shader.use();
+        auto view = camera.getViewMatrix();
+        auto projection = camera.getProjectionMatrix();
+        shader.setMat4("view", glm::value_ptr(view));
+        shader.setMat4("projection", glm::value_ptr(projection));
+        light.render(shader);
+        shader.setVec3("camPos", camera.position);
+        streamer.Draw(shader, camera);
+        glFinish();
+        frameMilliseconds.push_back(millisecondsSince(frameStart));
+    }
+    std::sort(frameMilliseconds.begin(), frameMilliseconds.end());
+    run.frameP50 = percentile(frameMilliseconds, 50.0);
+    run.frameP99 = percentile(frameMilliseconds, 99.0);
+    run.frameMax = frameMilliseconds.back();
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::string sweepName = "all", directory = (std::filesystem::temp_directory_path() / "learnopengl_stress").string(), outPath;
+    unsigned points = 5, frames = 30, tiles = 64, budgetTiles = 16;
+    bool render = true, stream = false, framesGiven = false;
+    int width = 1200, height = 900;
+    for (int i = 1; i < argc; i ++) {
+        std::string arg = argv[i];
+        if (arg == "--sweep" && i + 1 < argc) {
+            sweepName = argv[++ i];
+        } else if (arg == "--points" && i + 1 < argc) {
+            points = std::max(1, std::atoi(argv[++ i]));
+        } else if (arg == "--frames" && i + 1 < argc) {
+            frames = std::max(1, std::atoi(argv[++ i]));
+            framesGiven = true;
+        } else if (arg == "--stream") {
+            stream = true;
+        } else if (arg == "--tiles" && i + 1 < argc) {
+            tiles = std::max(1, std::atoi(argv[++ i]));
+        } else if (arg == "--budget-tiles" && i + 1 < argc) {
+            budgetTiles = std::max(1, std::atoi(argv[++ i]));
+        } else if (arg == "--dir" && i + 1 < argc) {
+            directory = argv[++ i];
+        } else if (arg == "--out" && i + 1 < argc) {
+            outPath = argv[++ i];
+        } else if (arg == "--no-render") {
+            render = false;
+        } else {
+            printf("unknown argument %s\n", arg.c_str());
+            return -1;
+        }
+    }
+    std::vector<const char*> sweeps;
+    for (const char* sweep : {"meshes", "vertices", "materials", "textures", "instances"}) {
+        if (sweepName == "all" || sweepName == sweep) {
+            sweeps.push_back(sweep);
+        }
+    }
+    if (sweeps.empty()) {
+        printf("unknown sweep %s\n", sweepName.c_str());
+        return -1;
+    }
+
+    const char* backend = "none";
+    GLFWwindow* window = nullptr;
+    if (render || stream) {
+        glfwSetErrorCallback(error_callback);
+        window = createHeadlessContext(&backend);
+        if (!window && stream) {
+            std::cerr << "ERROR::STRESS_SCALE: --stream uploads models and needs a GL context\n";
+            return -1;
+        }
+        if (!window) {
+            printf("no GL context, measuring load only\n");
+            render = false;
+        }
+    }
+
+    if (stream) {
+        StreamRun run;
+        run.tiles = tiles;
+        run.frames = framesGiven ? frames : 600;
+        bool ok{};
+        {
+            OffscreenTarget target;
+            if (!target.create(width, height)) {
+                std::cerr << "ERROR::STRESS_SCALE: offscreen framebuffer incomplete\n";
+                glfwTerminate();
+                return -1;
+            }
+            glEnable(GL_DEPTH_TEST);
+            Shader shader(FileSystem::getPath("src/lab1/model/model.vs").c_str(), FileSystem::getPath("src/lab1/model/model.fs").c_str());
+            ok = runStream(run, directory, budgetTiles, shader, width, height);
+        }
+        if (ok) {
+            printf("stream (GL: %s): %u tiles in %.1f ms, %u frames, budgets RAM %.2f MB / VRAM %.2f MB (%u tiles)\n", backend, run.tiles,
+                run.generateMs, run.frames, run.ramBudget / 1048576.0, run.vramBudget / 1048576.0, budgetTiles);
+            printf("  uploads %zu  evictions %zu  peak resident %zu  peak RAM %.2f MB  peak VRAM %.2f MB\n", run.uploads, run.evictions,
+                run.peakResident, run.peakRam / 1048576.0, run.peakVram / 1048576.0);
+            printf("  frame p50 %.2f ms  p99 %.2f ms  max %.2f ms\n", run.frameP50, run.frameP99, run.frameMax);
+            printf("  frames over budget %zu  LRU order violations %zu\n", run.overBudgetFrames, run.lruViolations);
+            ok = run.overBudgetFrames == 0 && run.lruViolations == 0;
+            if (!outPath.empty()) {
+                FILE* file = std::fopen(outPath.c_str(), "w");
+                bool written = file && std::fprintf(file, "{\"backend\": \"%s\", \"stream\": {\"tiles\": %u, \"frames\": %u, \"ramBudget\": %zu, "
+                    "\"vramBudget\": %zu, \"uploads\": %zu, \"evictions\": %zu, \"peakResident\": %zu, \"peakRam\": %zu, \"peakVram\": %zu, "
+                    "\"frameMs\": {\"p50\": %.3f, \"p99\": %.3f, \"max\": %.3f}, \"overBudgetFrames\": %zu, \"lruViolations\": %zu}}\n",
+                    backend, run.tiles, run.frames, run.ramBudget, run.vramBudget, run.uploads, run.evictions, run.peakResident, run.peakRam,
+                    run.peakVram, run.frameP50, run.frameP99, run.frameMax, run.overBudgetFrames, run.lruViolations) > 0;
+                if (file && std::fclose(file) != 0) {
+                    written = false;
+                }
+                if (!written) {
+                    std::cerr << "ERROR::STRESS_SCALE: failed to write " << outPath << '\n';
+                }
+            }
+        }
+        glfwTerminate();
+        return ok ? 0 : 1;
+    }
+
+    std::vector<SweepPoint> results;
+    {
+        OffscreenTarget target;
+        std::unique_ptr<Shader> shader;
+        if (render) {
+            if (!target.create(width, height)) {
+                std::cerr << "ERROR::STRESS_SCALE: offscreen framebuffer incomplete\n";
+                glfwTerminate();
+                return -1;
+            }
+            glEnable(GL_DEPTH_TEST);
+            shader = std::make_unique<Shader>(FileSystem::getPath("src/lab1/model/model.vs").c_str(), FileSystem::getPath("src/lab1/model/model.fs").c_str());
+        }
+
+        for (const char* sweep : sweeps) {
+            printf("%s (GL: %s)\n", sweep, backend);
+            printf("  %8s %9s %8s %10s %10s %10s %9s %10s %10s %9s %9s %9s %7s\n", "count", "triangles", "file MB", "generate", "cold load",
+                "warm load", "geom MB", "import RSS", "upload", "RSS MB", "frame p50", "frame p99", "draws");
+            for (unsigned p{}; p < points; p ++) {
+                StressSceneConfig config;
+                unsigned first = std::string(sweep) == "vertices" ? 256 : 1;
+                unsigned value = first << (2 * p);
+                sweptCount(config, sweep) = value;
+                // meshes pick materials round robin, so every material and texture needs a mesh to show up
+                if (std::string(sweep) == "materials" || std::string(sweep) == "textures") {
+                    config.meshes = std::max(config.meshes, value);
+                }
+
+                SweepPoint point{sweep, value};
+                std::string pointDirectory = directory + "/" + sweep + "_" + std::to_string(value);
+                std::filesystem::remove_all(pointDirectory);
+                auto start = std::chrono::steady_clock::now();
+                if (!writeStressScene(pointDirectory, config, &point.scene)) {
+                    return -1;
+                }
+                point.generateMs = millisecondsSince(start);
+
+                // cold: Assimp import plus the configured passes, writing the mesh cache
+                ModelData data;
+                resetPeakResident();
+                start = std::chrono::steady_clock::now();
+                bool loaded = Model::readData(point.scene.path, ModelConfig{}, data);
+                point.coldMs = millisecondsSince(start);
+                point.importPeakKB = statusKB("VmHWM:");
+                // warm: the same scene from its mesh cache
+                data = ModelData{};
+                start = std::chrono::steady_clock::now();
+                loaded = loaded && Model::readData(point.scene.path, ModelConfig{}, data);
+                point.warmMs = millisecondsSince(start);
+                if (!loaded) {
+                    std::cerr << "ERROR::STRESS_SCALE: failed to load " << point.scene.path << '\n';
+                    return -1;
+                }
+                for (auto& mesh : data.meshes) {
+                    point.geometryBytes += mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(unsigned);
+                }
+
+                if (render) {
+                    start = std::chrono::steady_clock::now();
+                    Model model(data);
+                    glFinish();
+                    point.uploadMs = millisecondsSince(start);
+                    renderPoint(point, model, *shader, config, frames, width, height);
+                    point.residentKB = statusKB("VmRSS:");
+                    model.releaseBuffers();
+                } else {
+                    point.residentKB = statusKB("VmRSS:");
+                }
+
+                printf("  %8u %9zu %8.2f %7.1f ms %7.1f ms %7.1f ms %9.2f %7.1f MB %7.1f ms %9.1f", value, point.scene.triangles,
+                    point.scene.fileBytes / 1048576.0, point.generateMs, point.coldMs, point.warmMs, point.geometryBytes / 1048576.0,
+                    point.importPeakKB / 1024.0, point.uploadMs, point.residentKB / 1024.0);
+                if (point.rendered) {
+                    printf(" %6.2f ms %6.2f ms %7llu\n", point.frameP50, point.frameP99, static_cast<unsigned long long>(point.drawCalls));
+                } else {
+                    printf(" %9s %9s %7s\n", "-", "-", "-");
+                }
+                fflush(stdout);
+                results.push_back(point);
+            }
+        }
+    }
+
+    if (!outPath.empty()) {
+        FILE* file = std::fopen(outPath.c_str(), "w");
+        if (!file) {
+            std::cerr << "ERROR::STRESS_SCALE: failed to write " << outPath << '\n';
+        } else {
+            std::fprintf(file, "{\"backend\": \"%s\", \"points\": [\n", backend);
+            for (size_t i{}; i < results.size(); i ++) {
+                auto& point = results[i];
+                std::fprintf(file, "  {\"sweep\": \"%s\", \"value\": %u, \"vertices\": %zu, \"triangles\": %zu, \"fileBytes\": %zu, "
+                    "\"generateMs\": %.3f, \"coldLoadMs\": %.3f, \"warmLoadMs\": %.3f, \"geometryBytes\": %zu, \"importPeakKB\": %zu, "
+                    "\"uploadMs\": %.3f, \"residentKB\": %zu",
+                    point.sweep, point.value, point.scene.vertices, point.scene.triangles, point.scene.fileBytes, point.generateMs,
+                    point.coldMs, point.warmMs, point.geometryBytes, point.importPeakKB, point.uploadMs, point.residentKB);
+                if (point.rendered) {
+                    std::fprintf(file, ", \"frameMs\": {\"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f}, \"drawCalls\": %llu, \"trianglesDrawn\": %llu",
+                        point.frameP50, point.frameP95, point.frameP99, point.frameMax,
+                        static_cast<unsigned long long>(point.drawCalls), static_cast<unsigned long long>(point.triangles));
+                }
+                std::fprintf(file, "}%s\n", i + 1 < results.size() ? "," : "");
+            }
+            std::fprintf(file, "]}\n");
+            if (std::fclose(file) != 0) {
+                std::cerr << "ERROR::STRESS_SCALE: failed to write " << outPath << '\n';
+            }
+        }
+    }
+
+    if (window) {
+        glfwTerminate();
+    }
+    return 0;
+}
@@ -0,0 +1,63 @@
+/*
+ * cost of one TRACE_SCOPE with tracing off and on, on the calling thread and on pool workers
+ * usage: bench_trace_overhead [scopes per run]
+ * set LEARNOPENGL_TRACE=<file.json> to also keep the recorded scopes (the rings hold the last 64k per thread)
+*/
+#include "header.h"
+#include "../bench_util.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+// the loop body must not be optimized away, nor cost more than the scope
+volatile unsigned sink;
+
+double scopeCost(size_t scopes) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i{}; i < scopes; i ++) {
+        TRACE_SCOPE("bench scope");
+        sink = static_cast<unsigned>(i);
+    }
+    return nanosecondsSince(start) / scopes;
+}
+
+double emptyCost(size_t scopes) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i{}; i < scopes; i ++) {
+        sink = static_cast<unsigned>(i);
+    }
+    return nanosecondsSince(start) / scopes;
+}
+
+int main(int argc, char** argv) {
+    size_t scopes = argc > 1 ? std::max(1, std::atoi(argv[1])) : 10000000;
+    bool fromEnvironment = traceEnabled;
+    TraceRecorder::global().setThreadName("main");
+
+    double empty = emptyCost(scopes);
+    traceEnabled = false;
+    double disabled = scopeCost(scopes) - empty;
+    traceEnabled = true;
+    double enabled = scopeCost(scopes) - empty;
+
+    // every worker records into its own ring, no contention
+    auto& pool = ThreadPool::global();
+    size_t tasks = pool.size() + 1;
+    auto start = std::chrono::steady_clock::now();
+    pool.parallelFor(tasks, [&](size_t) { scopeCost(scopes / tasks); });
+    double parallel = nanosecondsSince(start) / (scopes / tasks * tasks);
+    traceEnabled = fromEnvironment;
+
+    printf("scopes %zu  threads %zu  timestamp %s\n", scopes, tasks,
+#ifdef TRACE_TSC
+        "rdtsc"
+#else
+        "steady_clock"
+#endif
+    );
+    printf("  disabled     %7.2f ns/scope\n", disabled);
+    printf("  enabled      %7.2f ns/scope\n", enabled);
+    printf("  all threads  %7.2f ns/scope (wall time over all scopes)\n", parallel);
+    return 0;
+}
@@ -19,6 +19,9 @@ bool wireFrame = false;
 glm::vec3 displacement = glm::vec3(0.0f, 0.0f, 0.0f);            // model matrix parameters
 glm::vec3 scale = glm::vec3(1.0f, 1.0f, 1.0f);
 float rotate = 0.0f;
+int instanceCount = 1;                                           // copies drawn through ModelInstance
+float instanceSpacing = 3.0f;
+bool occlusionCulling = false;                                   // CPU occlusion test of the instances
 
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f)); // camera
 
@@ -32,6 +35,7 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 void processInput(GLFWwindow* window);
 
 int main() {
+    TraceRecorder::global().setThreadName("main");
     // error message
     glfwSetErrorCallback(error_callback);
     if (!glfwInit()) {
@@ -75,100 +79,161 @@ int main() {
     // stbi flip y-axis
     // stbi_set_flip_vertically_on_load(true); // here, the texture is upside down
     
-    // shader
-    Shader shader("model.vs", "model.fs");
-
-    // model
-    Model ourModel(FileSystem::getPath("resource/model/creeper/Creeper.obj"));
-
-    // light
-    Light light({
-        {10.0f, 30.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, 0.2f, 5.0f
-    });
-
-    // imgui implementation
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImGuiIO& io = ImGui::GetIO(); (void) io;
-    io.Fonts->AddFontFromFileTTF(FileSystem::getPath("resource/font/Consolas.ttf").c_str(), 18);
-    io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard; // enable keyboard controls
-    io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;  // enable gamepad controls
-
-    // setup gui style
-    ImGui::StyleColorsDark();
-    // ImGui::StyleColorsLight();
-
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
-    ImGui_ImplOpenGL3_Init();
+    // everything owning GL objects (textures, instance buffers, profiler queries) is destroyed at the end
+    // of this block, while the context is still current; after glfwTerminate() it cannot be checked for
+    {
+        // shader
+        Shader shader("model.vs", "model.fs");
+
+        // model
+        Model ourModel(FileSystem::getPath("resource/model/creeper/Creeper.obj"), false, {.asyncTextures = true});
+        ModelInstance ourInstances(ourModel);
+        OcclusionBuffer occlusionBuffer;
+        // what the instance buffer was last built from; upload() only runs when one of them changes
+        glm::mat4 instancedModel(0.0f);
+        int instancedCount = 0;
+        float instancedSpacing = 0.0f;
+
+        // light
+        Light light({
+            {10.0f, 30.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, 0.2f, 5.0f
+        });
+
+        // imgui implementation
+        IMGUI_CHECKVERSION();
+        ImGui::CreateContext();
+        ImGuiIO& io = ImGui::GetIO(); (void) io;
+        io.Fonts->AddFontFromFileTTF(FileSystem::getPath("resource/font/Consolas.ttf").c_str(), 18);
+        io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard; // enable keyboard controls
+        io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;  // enable gamepad controls
+
+        // setup gui style
+        ImGui::StyleColorsDark();
+        // ImGui::StyleColorsLight();
+
+        ImGui_ImplGlfw_InitForOpenGL(window, true);
+        ImGui_ImplOpenGL3_Init();
+
+        FrameProfiler profiler;
     
-    while (!glfwWindowShouldClose(window)) {
-        glClearColor(0.2f, 0.2f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        if (wireFrame) {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        }
-        else {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        }
-
-        processInput(window);
-
-        currentFrame = glfwGetTime();
-        deltaFrame = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-
-        shader.use();
-
-        glm::mat4 model(1.0f);
-        model = glm::translate(model, displacement);
-        scale.y = scale.z = scale.x;
-        model = glm::scale(model, scale);
-        model = glm::rotate(model, glm::radians(rotate), glm::vec3(0.0f, 1.0f, 0.0f));
-        // model = glm::rotate(model, glm::radians((float)glfwGetTime() * 20.0f), glm::vec3(0.0f, 0.5f, 0.0f));
-        auto view = camera.getViewMatrix();
-        auto projection = glm::perspective(glm::radians(camera.fov_zoom), (float) WND_WIDTH / WND_HEIGHT, 0.1f, 100.0f);
-
-        glm::mat4 normal = glm::transpose(model);
-        normal = glm::inverse(normal);
-
-        shader.setMat4("model", glm::value_ptr(model));
-        shader.setMat4("view", glm::value_ptr(view));
-        shader.setMat4("projection", glm::value_ptr(projection));
-        shader.setMat4("NormalMatrix",glm::value_ptr(normal));
-
-        light.pos = glm::vec3(10.0f * cos(currentFrame), 10.0f, 10.0f * sin(currentFrame));
-        light.render(shader);
-        shader.setVec3("camPos", camera.position);
-
-        ourModel.Draw(shader);
+        while (!glfwWindowShouldClose(window)) {
+            TRACE_SCOPE("frame");
+            profiler.beginFrame();
+            glClearColor(0.2f, 0.2f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            if (wireFrame) {
+                glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+            }
+            else {
+                glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            }
+
+            processInput(window);
+
+            // swap in textures decoded since the last frame
+            AsyncTextureLoader::global().poll();
+            ProfileScope sceneScope(profiler, "scene");
+
+            currentFrame = glfwGetTime();
+            deltaFrame = currentFrame - lastFrame;
+            lastFrame = currentFrame;
+
+            shader.use();
+
+            glm::mat4 model(1.0f);
+            model = glm::translate(model, displacement);
+            scale.y = scale.z = scale.x;
+            model = glm::scale(model, scale);
+            model = glm::rotate(model, glm::radians(rotate), glm::vec3(0.0f, 1.0f, 0.0f));
+            // model = glm::rotate(model, glm::radians((float)glfwGetTime() * 20.0f), glm::vec3(0.0f, 0.5f, 0.0f));
+            camera.aspect = (float) WND_WIDTH / WND_HEIGHT;
+            auto view = camera.getViewMatrix();
+            auto projection = camera.getProjectionMatrix();
+
+            glm::mat4 normal = glm::transpose(model);
+            normal = glm::inverse(normal);
+
+            shader.setMat4("model", glm::value_ptr(model));
+            shader.setMat4("view", glm::value_ptr(view));
+            shader.setMat4("projection", glm::value_ptr(projection));
+            shader.setMat4("NormalMatrix",glm::value_ptr(normal));
+
+            light.pos = glm::vec3(10.0f * cos(currentFrame), 10.0f, 10.0f * sin(currentFrame));
+            light.render(shader);
+            shader.setVec3("camPos", camera.position);
+
+            if (instanceCount > 1) {
+                // square grid of copies around the model transform, one instanced draw per mesh;
+                // rebuilt only when a slider moved, culling below is the only per-frame work
+                if (model != instancedModel || instanceCount != instancedCount || instanceSpacing != instancedSpacing) {
+                    int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(instanceCount))));
+                    ourInstances.transforms.resize(instanceCount);
+                    for (int i{}; i < instanceCount; i ++) {
+                        glm::vec3 offset((i % side - side / 2) * instanceSpacing, 0.0f, (i / side - side / 2) * instanceSpacing);
+                        ourInstances.transforms[i] = glm::translate(glm::mat4(1.0f), offset) * model;
+                    }
+                    ourInstances.upload();
+                    instancedModel = model;
+                    instancedCount = instanceCount;
+                    instancedSpacing = instanceSpacing;
+                }
+                if (occlusionCulling) {
+                    occlusionBuffer.clear(projection * view);
+                }
+                // the instance transforms already hold the model matrix
+                setModelMatrix(shader, glm::mat4(1.0f));
+                ourInstances.Draw(shader, camera.frustum(), occlusionCulling ? &occlusionBuffer : nullptr);
+            } else {
+                ourModel.Draw(shader, camera, model);
+            }
         
-        // ImGui: view parameters
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
-        // ImGui::ShowDemoWindow();
-        ImGui::Text("OpenGL Config");
-        ImGui::SliderFloat("rotate_angle", &rotate, -120.0f, 120.0f);
-        ImGui::SliderFloat3("displacement", &displacement.x, -5.0f, 5.0f);
-        ImGui::SliderFloat("scale", &scale.x, -2.0f, 2.0f);
-        ImGui::SliderFloat3("camera_position", &camera.position.x, -5.0f, 5.0f);
-        ImGui::Checkbox("Enable wire frame", &wireFrame);
-        ImGui::Text("\nFOV: %f", camera.fov_zoom);
-        ImGui::Text("PICTH: %f", camera.pitch);
-        ImGui::Text("YAW: %f", camera.yaw);
-        ImGui::Text("lookAT Matrix:\n  %.3f, %.3f, %.3f\n  %.3f, %.3f, %.3f\n  %.3f, %.3f, %.3f", 
-            view[0][0], view[1][0], view[2][0],
-            view[0][1], view[1][1], view[2][1],
-            view[0][2], view[1][2], view[2][2]
-        );
-        ImGui::Text("Average fps: %.4f", ImGui::GetIO().Framerate);
-
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+            sceneScope.end();
+
+            // ImGui: view parameters
+            ProfileScope uiScope(profiler, "ui");
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            ImGui::NewFrame();
+            // ImGui::ShowDemoWindow();
+            ImGui::Text("OpenGL Config");
+            ImGui::SliderFloat("rotate_angle", &rotate, -120.0f, 120.0f);
+            ImGui::SliderFloat3("displacement", &displacement.x, -5.0f, 5.0f);
+            ImGui::SliderFloat("scale", &scale.x, -2.0f, 2.0f);
+            ImGui::SliderFloat3("camera_position", &camera.position.x, -5.0f, 5.0f);
+            ImGui::Checkbox("Enable wire frame", &wireFrame);
+            ImGui::SliderInt("instances", &instanceCount, 1, 50000);
+            ImGui::SliderFloat("instance_spacing", &instanceSpacing, 1.0f, 10.0f);
+            ImGui::Checkbox("occlusion_culling", &occlusionCulling);
+            ImGui::Text("visible instances: %zu", instanceCount > 1 ? ourInstances.visibleCount() : size_t(1));
+            ImGui::Text("\nFOV: %f", camera.fov_zoom);
+            ImGui::Text("PICTH: %f", camera.pitch);
+            ImGui::Text("YAW: %f", camera.yaw);
+            ImGui::Text("lookAT Matrix:\n  %.3f, %.3f, %.3f\n  %.3f, %.3f, %.3f\n  %.3f, %.3f, %.3f", 
+                view[0][0], view[1][0], view[2][0],
+                view[0][1], view[1][1], view[2][1],
+                view[0][2], view[1][2], view[2][2]
+            );
+            ImGui::Text("Average fps: %.4f", ImGui::GetIO().Framerate);
+            profiler.drawPanel();
+
+            ImGui::Render();
+            // the ImGui backend draws with its own glDrawElements, one per command
+            ImDrawData* drawData = ImGui::GetDrawData();
+            uint64_t uiDraws = 0;
+            for (const ImDrawList* list : drawData->CmdLists) {
+                uiDraws += list->CmdBuffer.Size;
+            }
+            profiler.addDraws(uiDraws, drawData->TotalIdxCount / 3);
+            ImGui_ImplOpenGL3_RenderDrawData(drawData);
+            uiScope.end();
+
+            ProfileScope swapScope(profiler, "swap");
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+            swapScope.end();
+            profiler.endFrame();
+        }
     }
 
     ImGui_ImplOpenGL3_Shutdown();